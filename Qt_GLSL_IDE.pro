@@ -11,6 +11,12 @@ win32 {
     LIBS += -lOpengl32
 }
 
+# "qmake CONFIG+=spirv" adds the SPIR-V pipeline, which needs glslang and SPIRV-Tools
+spirv {
+    DEFINES += HAVE_SPIRV
+    LIBS += -lglslang -lSPIRV -lglslang-default-resource-limits -lSPIRV-Tools-opt -lSPIRV-Tools
+}
+
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = Qt_GLSL_IDE
@@ -31,16 +37,62 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += main.cpp\
         ide.cpp \
     glwidget.cpp \
+    renderthread.cpp \
+    shaderbuild.cpp \
     textedit.cpp \
     about.cpp \
-    glslsyntax.cpp
+    glslsyntax.cpp \
+    framecapture.cpp \
+    capturedialog.cpp \
+    glslfile.cpp \
+    shaderbench.cpp \
+    texturemanager.cpp \
+    glstate.cpp \
+    statsview.cpp \
+    glresource.cpp \
+    objmodel.cpp \
+    meshscene.cpp \
+    assetwatcher.cpp \
+    builtins.cpp \
+    spirvcompiler.cpp \
+    batchvalidator.cpp \
+    computestage.cpp \
+    imagediff.cpp \
+    offscreenrenderer.cpp \
+    regressionrunner.cpp \
+    parametersweep.cpp \
+    startuptrace.cpp \
+    costheatmap.cpp
 
 HEADERS  += ide.h \
     glwidget.h \
+    renderthread.h \
+    shaderbuild.h \
     textedit.h \
     about.h \
     glslsyntax.h \
-    vec.h
+    vec.h \
+    framecapture.h \
+    capturedialog.h \
+    glslfile.h \
+    shaderbench.h \
+    texturemanager.h \
+    glstate.h \
+    statsview.h \
+    glresource.h \
+    objmodel.h \
+    meshscene.h \
+    assetwatcher.h \
+    builtins.h \
+    spirvcompiler.h \
+    batchvalidator.h \
+    computestage.h \
+    imagediff.h \
+    offscreenrenderer.h \
+    regressionrunner.h \
+    parametersweep.h \
+    startuptrace.h \
+    costheatmap.h
 
 FORMS    += ide.ui
 
@@ -0,0 +1,93 @@
+#include "assetwatcher.h"
+#include <QFileInfo>
+#include <QStringList>
+
+static const int quietTime = 200;	// ms without changes before a file counts as saved
+
+AssetWatcher::AssetWatcher(QObject *parent) : QObject(parent)
+{
+	quiet.setSingleShot(true);
+	quiet.setInterval(quietTime);
+	connect(&quiet, SIGNAL(timeout()), this, SLOT(flush()));
+	connect(&watcher, SIGNAL(fileChanged(QString)), this, SLOT(fileChanged(QString)));
+	connect(&watcher, SIGNAL(directoryChanged(QString)), this, SLOT(directoryChanged(QString)));
+}
+
+void AssetWatcher::watch(const QString &path, Kind kind)
+{
+	if(path.isEmpty()) return;
+	QString file = QFileInfo(path).absoluteFilePath();
+	kinds[file] |= kind;
+	update();
+}
+
+void AssetWatcher::unwatch(Kind kind)
+{
+	for(auto i = kinds.begin(); i != kinds.end();)
+	{
+		i.value() &= ~kind;
+		if(i.value() == 0) i = kinds.erase(i);
+		else ++i;
+	}
+	update();
+}
+
+void AssetWatcher::unwatch(const QString &path, Kind kind)
+{
+	auto i = kinds.find(QFileInfo(path).absoluteFilePath());
+	if(i == kinds.end()) return;
+	i.value() &= ~kind;
+	if(i.value() == 0) kinds.erase(i);
+	update();
+}
+
+void AssetWatcher::update()
+{
+	QSet<QString> files, directories;
+	for(auto i = kinds.constBegin(); i != kinds.constEnd(); ++i)
+	{
+		QFileInfo info(i.key());
+		if(info.exists()) files.insert(i.key());
+		directories.insert(info.absolutePath());
+	}
+
+	QStringList stale;
+	for(const QString &path : watcher.files() + watcher.directories())
+		if(!files.contains(path) && !directories.contains(path)) stale.append(path);
+	if(!stale.isEmpty()) watcher.removePaths(stale);
+
+	QStringList added;
+	for(const QString &path : files + directories)
+		if(!watcher.files().contains(path) && !watcher.directories().contains(path)) added.append(path);
+	if(!added.isEmpty()) watcher.addPaths(added);
+	// only the difference is passed on, adding and removing paths is expensive on some platforms
+}
+
+void AssetWatcher::fileChanged(QString path)
+{
+	pending.insert(path);
+	quiet.start();	// restarts the wait if it is already running
+}
+
+void AssetWatcher::directoryChanged(QString directory)
+{
+	for(auto i = kinds.constBegin(); i != kinds.constEnd(); ++i)
+		if(QFileInfo(i.key()).absolutePath() == directory && !watcher.files().contains(i.key())
+				&& QFileInfo::exists(i.key()))
+			fileChanged(i.key());	// replaced by a rename, or created after it was first watched
+}
+
+void AssetWatcher::flush()
+{
+	QSet<QString> files = pending;
+	pending.clear();
+	update();	// watch files again that were replaced in the meantime
+
+	for(const QString &path : files)
+	{
+		auto i = kinds.constFind(path);
+		if(i == kinds.constEnd() || !QFileInfo::exists(path)) continue;	// unwatched or deleted since
+		for(int kind = Project; kind <= Model; kind <<= 1)
+			if(i.value() & kind) emit changed(kind, path);
+	}
+}
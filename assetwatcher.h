@@ -0,0 +1,47 @@
+#ifndef ASSETWATCHER_H
+#define ASSETWATCHER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+/** CLARIFICATION:
+ * Editors rarely save a file in one go: many write it in several chunks, or write a new file and
+ * rename it over the old one, which makes QFileSystemWatcher lose track of it. AssetWatcher therefore
+ * also watches the folders the files are in, picks files up again once they reappear, and waits until
+ * a file has been quiet for a moment before it reports one change for the whole burst.
+ **/
+
+class AssetWatcher : public QObject
+{
+	Q_OBJECT
+public:
+	enum Kind { Project = 1, Include = 2, Texture = 4, Model = 8 };
+
+	explicit AssetWatcher(QObject *parent = nullptr);
+
+	void watch(const QString &path, Kind);
+	void unwatch(Kind);
+	void unwatch(const QString &path, Kind);
+
+signals:
+	void changed(int, QString);	// kind and path, once per burst of changes
+
+private slots:
+	void fileChanged(QString);
+	void directoryChanged(QString);
+	void flush();
+
+private:
+	QFileSystemWatcher watcher;
+	QTimer quiet;
+	QHash<QString, int> kinds;	// watched file to the kinds it is watched as
+	QSet<QString> pending;
+
+	void update();
+};
+
+#endif // ASSETWATCHER_H
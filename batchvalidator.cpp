@@ -0,0 +1,186 @@
+#include "batchvalidator.h"
+#include <memory>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <GL/glew.h>
+#include "glslfile.h"
+#include "glwidget.h"
+#include "spirvcompiler.h"
+#include "shaderbuild.h"
+
+ValidationWorker::ValidationWorker(std::vector<ValidationJob> &jobs, std::atomic<size_t> &next,
+								   QOpenGLContext *context, QOffscreenSurface *surface)
+	: jobs(jobs), next(next), context(context), surface(surface) {}
+
+void ValidationWorker::run()
+{
+	bool current = !context || context->makeCurrent(surface);
+	for(size_t i = next++; i < jobs.size(); i = next++)
+	{
+		ValidationJob &job = jobs[i];
+		if(!job.prepared) continue;	// reading or #include failed, already reported
+		if(!current)	// GL calls without a current context would crash or go nowhere
+		{
+			job.log += "Could not make the worker's GL context current.\n";
+			job.passed = false;
+			continue;
+		}
+
+		QElapsedTimer timer;
+		timer.start();
+		job.passed = context ? compileGL(job) : compileGlslang(job);
+		job.milliseconds = timer.nsecsElapsed() / 1e6;
+	}
+	if(!context) return;
+	if(current) context->doneCurrent();
+	context->moveToThread(QCoreApplication::instance()->thread());	// back to be deleted where it was made
+}
+
+bool ValidationWorker::compileGL(ValidationJob &job)
+{
+	GLuint shaders[2] = { glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER) };
+	// plain GL objects - the resource registry belongs to the GUI thread
+
+	ShaderBuild::compile(shaders[0], job.vertex);
+	ShaderBuild::compile(shaders[1], job.fragment);
+	bool compiled = ShaderBuild::compiled(shaders[0], "vertex", job.log);
+	compiled = ShaderBuild::compiled(shaders[1], "fragment", job.log) && compiled;
+	// both are compiled first, so drivers that compile in the background can overlap them
+
+	if(compiled)
+	{
+		GLuint program = glCreateProgram();
+		ShaderBuild::link(program, {shaders[0], shaders[1]});
+		compiled = ShaderBuild::linked(program, job.log);
+		glDeleteProgram(program);
+	}
+	glDeleteShader(shaders[0]);
+	glDeleteShader(shaders[1]);
+	return compiled;
+}
+
+bool ValidationWorker::compileGlslang(ValidationJob &job)
+{
+	SpirvProgram spirv;
+	return SpirvCompiler::compile(job.vertex, job.fragment, spirv, job.log);
+}
+
+int BatchValidator::run(const QString &directory, int threads, bool glslang)
+{
+	QTextStream out(stdout), err(stderr);
+	if(threads < 1) threads = QThread::idealThreadCount();
+
+	QStringList paths;
+	QDirIterator files(directory, QStringList() << "*.glsl", QDir::Files, QDirIterator::Subdirectories);
+	while(files.hasNext()) paths.append(files.next());
+	paths.sort();
+	if(paths.isEmpty())
+	{
+		err << "No .glsl files found in " << directory << "\n";
+		return 2;
+	}
+
+	std::vector<std::unique_ptr<QOffscreenSurface>> surfaces;
+	std::vector<std::unique_ptr<QOpenGLContext>> contexts;
+	bool multiDraw = false;
+	QString compiler = "glslang";
+	if(!glslang)	// every worker gets its own context, created here because it has to be on the GUI thread
+	{
+		for(int i = 0; i < threads; ++i)
+		{
+			std::unique_ptr<QOffscreenSurface> surface(new QOffscreenSurface());
+			surface->create();
+			std::unique_ptr<QOpenGLContext> context(new QOpenGLContext());
+			if(!contexts.empty()) context->setShareContext(contexts[0].get());
+			if(!context->create()) break;
+			surfaces.push_back(std::move(surface));
+			contexts.push_back(std::move(context));
+		}
+
+		if(!contexts.empty() && contexts[0]->makeCurrent(surfaces[0].get()))
+		{
+			glewExperimental = GL_TRUE;
+			glewInit();	// function pointers are shared by every context of the driver
+			multiDraw = MeshScene::multiDrawSupported();
+			compiler = QString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+			contexts[0]->doneCurrent();
+		}
+		else contexts.clear();
+
+		if(contexts.empty())
+		{
+			if(!SpirvCompiler::available())
+			{
+				err << "Could not create a GL context, and this build has no glslang to fall back to.\n";
+				return 2;
+			}
+			err << "Could not create a GL context, validating with glslang instead.\n";
+			glslang = true;
+		}
+		else threads = int(contexts.size());
+	}
+	else if(!SpirvCompiler::available())
+	{
+		err << "This build has no SPIR-V support, rebuild with \"qmake CONFIG+=spirv\".\n";
+		return 2;
+	}
+
+	std::vector<ValidationJob> jobs(paths.size());
+	for(int i = 0; i < paths.size(); ++i)	// reading and the header are done up front, on this thread
+	{
+		ValidationJob &job = jobs[i];
+		job.path = paths[i];
+		GLSLFile project;
+		if(!project.read(job.path))
+		{
+			job.log = "Not a GLSL project file.\n";
+			continue;
+		}
+
+		QStringList included;
+		QString error;
+		QString folder = QFileInfo(job.path).absolutePath();
+		if(!GLSLFile::expandIncludes(project.vertex, folder, included, error)
+				|| !GLSLFile::expandIncludes(project.fragment, folder, included, error))
+		{
+			job.log = error + "\n";
+			continue;
+		}
+		job.vertex = GLWidget::assemble(GL_VERTEX_SHADER, project.vertex.toStdString(), multiDraw, glslang);
+		job.fragment = GLWidget::assemble(GL_FRAGMENT_SHADER, project.fragment.toStdString(), multiDraw, glslang);
+		job.prepared = true;
+	}
+
+	QElapsedTimer total;
+	total.start();
+	std::atomic<size_t> next(0);
+	std::vector<std::unique_ptr<ValidationWorker>> workers;
+	for(int i = 0; i < threads; ++i)
+	{
+		QOpenGLContext *context = glslang ? nullptr : contexts[i].get();
+		workers.emplace_back(new ValidationWorker(jobs, next, context, glslang ? nullptr : surfaces[i].get()));
+		if(context) context->moveToThread(workers.back().get());	// a context is current on one thread at a time
+		workers.back()->start();
+	}
+	for(auto &worker : workers) worker->wait();
+	double wall = total.nsecsElapsed() / 1e6;
+
+	int failed = 0;
+	double compiling = 0;
+	for(const ValidationJob &job : jobs)
+	{
+		compiling += job.milliseconds;
+		if(!job.passed) ++failed;
+		out << (job.passed ? "ok    " : "FAIL  ") << QString::number(job.milliseconds, 'f', 1).rightJustified(8)
+			<< " ms  " << QDir(directory).relativeFilePath(job.path) << "\n";
+		for(const QString &line : job.log.trimmed().split('\n', QString::SkipEmptyParts))
+			out << "        " << line << "\n";
+	}
+	out << jobs.size() << " files, " << failed << " failed, " << QString::number(wall, 'f', 0) << " ms ("
+		<< QString::number(compiling, 'f', 0) << " ms compiling on " << threads << " threads, " << compiler << ")\n";
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,57 @@
+#ifndef BATCHVALIDATOR_H
+#define BATCHVALIDATOR_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <QString>
+#include <QThread>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+
+/** CLARIFICATION:
+ * "Qt_GLSL_IDE --validate <folder>" compiles and links every .glsl project below the folder without
+ * opening a window. Every worker thread owns an offscreen GL context, all of them sharing objects with
+ * one another, and takes the next project from a shared counter until none are left. When no GL context
+ * can be created (e.g. on a build server) and the SPIR-V pipeline is built in, glslang does the checking.
+ *
+ * The results are printed in file order once all workers are done, and the exit code is 1 if any
+ * project failed, or 2 if there was nothing to validate.
+ **/
+
+struct ValidationJob
+{
+	QString path;
+	std::string vertex, fragment;	// complete sources, with the IDE's header and includes expanded
+	bool prepared = false;
+	QString log;
+	double milliseconds = 0;
+	bool passed = false;
+};
+
+class ValidationWorker : public QThread
+{
+public:
+	ValidationWorker(std::vector<ValidationJob>&, std::atomic<size_t> &next,
+					 QOpenGLContext *context, QOffscreenSurface *surface);
+
+protected:
+	void run() override;
+
+private:
+	std::vector<ValidationJob> &jobs;
+	std::atomic<size_t> &next;
+	QOpenGLContext *context;	// null when glslang does the work
+	QOffscreenSurface *surface;
+
+	static bool compileGL(ValidationJob&);
+	static bool compileGlslang(ValidationJob&);
+};
+
+class BatchValidator
+{
+public:
+	static int run(const QString &directory, int threads, bool glslang);
+};
+
+#endif // BATCHVALIDATOR_H
@@ -0,0 +1,134 @@
+#include "builtins.h"
+#include <cstring>
+#include <QRegularExpression>
+
+BuiltInUniforms::BuiltInUniforms(GLResources &resources) : resources(resources) {}
+
+const char *BuiltInUniforms::declaration(bool explicitBinding)
+{
+	#define BUILT_IN_MEMBERS \
+		"{\n" \
+		"	vec4 date;\n" \
+		"	vec4 mouse;\n" \
+		"	vec2 resolution;\n" \
+		"	float time;\n" \
+		"	float deltaTime;\n" \
+		"	int frame;\n" \
+		"};\n"
+
+	static_assert(binding == 0, "the explicit binding below has to match");
+	if(explicitBinding) return "layout(std140, binding = 0) uniform BuiltIns\n" BUILT_IN_MEMBERS;
+	return "layout(std140) uniform BuiltIns\n" BUILT_IN_MEMBERS;
+	// SPIR-V keeps no names to look the block up by, so it needs the binding in the source
+
+	#undef BUILT_IN_MEMBERS
+}
+
+std::string BuiltInUniforms::strip(const std::string &source)
+{
+	static const QRegularExpression declared(
+				"\\buniform\\s+(?:(?:lowp|mediump|highp)\\s+)?\\w+\\s+"
+				"(?:date|mouse|resolution|time|deltaTime|frame)\\s*;");
+	return QString::fromStdString(source).remove(declared).toStdString();
+	// only the declaration goes, the line stays so error line numbers don't move
+}
+
+void BuiltInUniforms::create(GLState &state)
+{
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	stride = (sizeof(BuiltIns) + alignment - 1) / alignment * alignment;
+	// every copy in the ring has to start at an offset the driver can bind
+
+	buffer = GLBuffer(resources, "built-in uniforms");
+	state.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+	if(GLEW_ARB_buffer_storage)
+	{
+		GLsizeiptr size = stride * passesPerFrame * framesInFlight;
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+		mapped = static_cast<char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+		buffer.setSize(size);
+		// mapped once for the lifetime of the buffer, coherent so writes need no flush
+		if(!mapped)	// immutable storage can't be reallocated, the fallback needs a buffer of its own
+		{
+			buffer = GLBuffer(resources, "built-in uniforms");
+			state.invalidate();	// the new buffer may get the old one's name, which the tracker thinks is bound
+			state.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+		}
+	}
+	region = pass = 0;
+	if(!mapped)
+	{
+		state.bufferData(GL_UNIFORM_BUFFER, sizeof(BuiltIns), nullptr, GL_DYNAMIC_DRAW);
+		buffer.setSize(sizeof(BuiltIns));
+		state.bindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+	}
+}
+
+void BuiltInUniforms::update(GLState &state, const BuiltIns &values)
+{
+	if(!buffer) return;
+	if(!mapped)	// GL 3.3, let the driver take care of the copy still being read
+	{
+		state.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+		state.bufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(BuiltIns), &values);
+		state.bindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+		return;
+	}
+
+	if(pass == passesPerFrame) nextRegion();	// more passes than this frame's region holds
+	GLintptr offset = (region * passesPerFrame + pass++) * stride;
+	std::memcpy(mapped + offset, &values, sizeof(BuiltIns));
+	state.bindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, sizeof(BuiltIns));
+}
+
+void BuiltInUniforms::nextFrame()
+{
+	if(mapped && pass > 0) nextRegion();	// a frame without passes leaves its region to the next one
+}
+
+void BuiltInUniforms::nextRegion()
+{
+	if(fences[region]) glDeleteSync(fences[region]);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	// every draw that reads this region has been issued by now
+	region = (region + 1) % framesInFlight;
+	pass = 0;
+	wait(fences[region]);	// until the GPU is done with the frame that last used the next region
+}
+
+void BuiltInUniforms::wait(GLsync &sync)
+{
+	if(!sync) return;
+	GLenum result;
+	do result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+	while(result == GL_TIMEOUT_EXPIRED);	// a very slow frame, its uniforms can't be overwritten before it's done
+	if(result == GL_WAIT_FAILED) glFinish();	// the fence can't be waited on, so wait for everything
+	glDeleteSync(sync);
+	sync = 0;
+}
+
+void BuiltInUniforms::bindBlock(GLuint program)
+{
+	GLuint index = glGetUniformBlockIndex(program, "BuiltIns");
+	if(index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, binding);
+	// the block is dropped by the compiler when a shader uses none of the built-ins
+}
+
+void BuiltInUniforms::release()
+{
+	for(GLsync &sync : fences)
+		if(sync)
+		{
+			glDeleteSync(sync);
+			sync = 0;
+		}
+	if(mapped)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		mapped = nullptr;
+	}
+	buffer.reset();
+}
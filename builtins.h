@@ -0,0 +1,73 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <string>
+#include <GL/glew.h>
+#include "glresource.h"
+#include "glstate.h"
+
+/** CLARIFICATION:
+ * The inputs every shader gets for free live in one std140 uniform block, declared in the header that is
+ * put in front of the editor's code, so they are set once per pass for every program instead of with a
+ * glUniform call per value and program:
+ *
+ * vec4 date		year, month, day and seconds since midnight
+ * vec4 mouse		xy is the position while a button is held, zw where it was pressed (negative once released)
+ * vec2 resolution	size of the output in pixels
+ * float time		seconds of shader time
+ * float deltaTime	seconds since the previous frame
+ * int frame		number of the frame being rendered
+ *
+ * Older shaders that declare any of these as plain uniforms still compile, the declarations are removed.
+ **/
+
+struct BuiltIns	// matches the std140 layout of the block
+{
+	GLfloat date[4];
+	GLfloat mouse[4];
+	GLfloat resolution[2];
+	GLfloat time;
+	GLfloat deltaTime;
+	GLint frame;
+	GLint padding[3];
+};
+
+class BuiltInUniforms
+{
+public:
+	explicit BuiltInUniforms(GLResources&);
+
+	// the functions below need the GL context to be current
+	void create(GLState&);
+	void nextFrame();	// once at the start of every frame
+	void update(GLState&, const BuiltIns&);	// once per pass
+	void release();
+	static void bindBlock(GLuint program);
+
+	static const char *declaration(bool explicitBinding = false);
+	static std::string strip(const std::string &source);
+	bool isPersistent() const { return mapped != nullptr; }
+
+private:
+	/** CLARIFICATION:
+	 * The persistent buffer holds one region per frame in flight, and every region a copy per pass (compute,
+	 * scene, heatmap, capture...). The ring moves on by a region per frame, so the only wait is for the frame
+	 * from three frames ago. A frame with more passes than a region holds (the A/B bench draws hundreds)
+	 * moves on early, waiting on older frames like the GL 3.3 path would.
+	 **/
+	static const int framesInFlight = 3;
+	static const int passesPerFrame = 8;
+	static const GLuint binding = 0;
+
+	GLResources &resources;
+	GLBuffer buffer;
+	char *mapped = nullptr;
+	GLsync fences[framesInFlight] = {};	// one per region, after the last draw that read it
+	GLsizeiptr stride = 0;
+	int region = 0, pass = 0;	// the next copy to write
+
+	void nextRegion();
+	static void wait(GLsync&);
+};
+
+#endif // BUILTINS_H
@@ -0,0 +1,93 @@
+#include "capturedialog.h"
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QStandardPaths>
+
+CaptureDialog::CaptureDialog(QWidget *parent) : QDialog(parent)
+{
+	setWindowTitle("Capture image sequence");
+
+	QFormLayout *layout = new QFormLayout(this);
+
+	directory = new QLineEdit(QStandardPaths::writableLocation(QStandardPaths::PicturesLocation));
+	QPushButton *browseButton = new QPushButton("Browse...");
+	connect(browseButton, SIGNAL(clicked()), this, SLOT(browse()));
+	QHBoxLayout *directoryRow = new QHBoxLayout();
+	directoryRow->addWidget(directory);
+	directoryRow->addWidget(browseButton);
+	layout->addRow("Folder:", directoryRow);
+
+	baseName = new QLineEdit("frame");
+	layout->addRow("File name:", baseName);
+
+	width = new QSpinBox();
+	width->setRange(1, 16384);
+	width->setValue(3840);
+	height = new QSpinBox();
+	height->setRange(1, 16384);
+	height->setValue(2160);
+	QHBoxLayout *sizeRow = new QHBoxLayout();
+	sizeRow->addWidget(width);
+	sizeRow->addWidget(height);
+	layout->addRow("Resolution:", sizeRow);
+	// the capture renders offscreen, so it can be larger than the GL window
+
+	frameCount = new QSpinBox();
+	frameCount->setRange(1, 1000000);
+	frameCount->setValue(1000);
+	layout->addRow("Frames:", frameCount);
+
+	startTime = new QDoubleSpinBox();
+	startTime->setDecimals(4);
+	startTime->setRange(0, 1e6);
+	layout->addRow("Start time:", startTime);
+
+	timeStep = new QDoubleSpinBox();
+	timeStep->setDecimals(4);
+	timeStep->setRange(0.0001, 1000);
+	timeStep->setValue(0.01);	// same increment the preview uses per frame
+	layout->addRow("Time step:", timeStep);
+
+	format = new QComboBox();
+	format->addItem("PNG (8 bit)");
+	format->addItem("OpenEXR (16 bit float)");
+	layout->addRow("Format:", format);
+
+	QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+	connect(buttons, SIGNAL(accepted()), this, SLOT(accept()));
+	connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+	layout->addRow(buttons);
+}
+
+CaptureSettings CaptureDialog::settings() const
+{
+	CaptureSettings s;
+	s.directory = directory->text();
+	s.baseName = baseName->text().isEmpty() ? "frame" : baseName->text();
+	s.width = width->value();
+	s.height = height->value();
+	s.frameCount = frameCount->value();
+	s.startTime = startTime->value();
+	s.timeStep = timeStep->value();
+	s.exr = format->currentIndex() == 1;
+	return s;
+}
+
+void CaptureDialog::accept()
+{
+	CaptureSettings s = settings();
+	if(FrameCapture::frameBytes(s) > FrameCapture::maxFrameBytes)
+	{
+		QMessageBox::warning(this, "Capture image sequence", "One frame of this size would take more than "
+							 + QString::number(FrameCapture::maxFrameBytes >> 20) + " MB, choose a smaller resolution"
+							 + (s.exr ? " or PNG." : "."));
+		return;
+	}
+	QDialog::accept();
+}
+
+void CaptureDialog::browse()
+{
+	QString path = QFileDialog::getExistingDirectory(this, "Capture folder", directory->text());
+	if(path != "") directory->setText(path);
+}
@@ -0,0 +1,36 @@
+#ifndef CAPTUREDIALOG_H
+#define CAPTUREDIALOG_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include <QComboBox>
+#include <QPushButton>
+#include <QFormLayout>
+#include <QDialogButtonBox>
+#include <QMessageBox>
+#include "framecapture.h"
+
+class CaptureDialog : public QDialog
+{
+	Q_OBJECT
+public:
+	explicit CaptureDialog(QWidget *parent = nullptr);
+
+	CaptureSettings settings() const;
+
+public slots:
+	void accept();
+
+private:
+	QLineEdit *directory, *baseName;
+	QSpinBox *width, *height, *frameCount;
+	QDoubleSpinBox *startTime, *timeStep;
+	QComboBox *format;
+
+private slots:
+	void browse();
+};
+
+#endif // CAPTUREDIALOG_H
@@ -0,0 +1,253 @@
+#include "computestage.h"
+#include <random>
+#include <algorithm>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QStringList>
+
+ComputeStage::ComputeStage(GLResources &resources) : resources(resources) {}
+
+bool ComputeStage::parse(const std::string &source, ComputeSpec &spec, QString &error)
+{
+	spec = ComputeSpec();
+	QStringList lines = QString::fromStdString(source).split('\n');
+	for(int i = 0; i < lines.size(); ++i)
+	{
+		QStringList words = lines[i].section("//", 0, 0).simplified().split(' ', QString::SkipEmptyParts);
+		if(words.size() < 2 || words[0] != "#pragma") continue;
+		QString where = " (line " + QString::number(i + 1) + ")";
+		QString what = words[1];
+		words = words.mid(2);
+
+		if(what == "workgroup" || what == "dispatch")
+		{
+			GLuint *size = what == "workgroup" ? spec.workgroup : spec.dispatch;
+			if(words.isEmpty() || words.size() > 3) { error = "Expected 1 to 3 sizes" + where; return false; }
+			for(int axis = 0; axis < 3; ++axis) size[axis] = axis < words.size() ? words[axis].toUInt() : 1;
+			if(!size[0] || !size[1] || !size[2]) { error = "Sizes have to be positive" + where; return false; }
+		}
+		else if(what == "buffer")
+		{
+			ComputeSpec::Buffer buffer;
+			if(words.size() != 3) { error = "Expected: #pragma buffer <binding> <zero|random|index|file> <floats|path>" + where; return false; }
+			buffer.binding = words[0].toUInt();
+			buffer.generator = words[1];
+			if(buffer.binding == 0) { error = "Storage buffer binding 0 belongs to the scene" + where; return false; }
+			if(buffer.generator == "file") buffer.file = words[2];
+			else if(buffer.generator == "zero" || buffer.generator == "random" || buffer.generator == "index")
+				buffer.floats = words[2].toULongLong();
+			else { error = "Unknown buffer contents \"" + buffer.generator + "\"" + where; return false; }
+			spec.buffers.push_back(buffer);
+		}
+		else if(what == "image")
+		{
+			ComputeSpec::Image image;
+			if(words.size() < 3) { error = "Expected: #pragma image <unit> <format> <width> <height>, or <unit> file <path>" + where; return false; }
+			image.unit = words[0].toUInt();
+			if(words[1] == "file") image.file = words[2];
+			else if(words.size() == 4)
+			{
+				static const QStringList names = QStringList() << "rgba8" << "rgba16f" << "rgba32f" << "r32f";
+				static const GLenum formats[] = { GL_RGBA8, GL_RGBA16F, GL_RGBA32F, GL_R32F };
+				int format = names.indexOf(words[1]);
+				if(format < 0) { error = "Unknown image format \"" + words[1] + "\"" + where; return false; }
+				image.format = formats[format];
+				image.width = words[2].toInt();
+				image.height = words[3].toInt();
+				if(image.width <= 0 || image.height <= 0) { error = "Image sizes have to be positive" + where; return false; }
+			}
+			else { error = "Expected: #pragma image <unit> <format> <width> <height>" + where; return false; }
+			spec.images.push_back(image);
+		}
+		else if(what == "points")
+		{
+			if(words.size() != 2) { error = "Expected: #pragma points <binding> <floats per point>" + where; return false; }
+			spec.pointsBinding = words[0].toInt();
+			spec.pointComponents = words[1].toInt();
+			if(spec.pointComponents < 1 || spec.pointComponents > 4)
+			{
+				error = "Points have 1 to 4 floats" + where;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+std::string ComputeStage::withWorkgroup(const std::string &source, const ComputeSpec &spec)
+{
+	if(!spec.workgroup[0]) return source;	// the shader declares its own local size
+	return QString("layout(local_size_x = %1, local_size_y = %2, local_size_z = %3) in;\n#line 1\n")
+			.arg(spec.workgroup[0]).arg(spec.workgroup[1]).arg(spec.workgroup[2]).toStdString() + source;
+}
+
+bool ComputeStage::setup(GLProgram &&built, const ComputeSpec &wanted, const QString &directory, QString &error)
+{
+	std::vector<std::pair<GLuint, GLBuffer>> newBuffers;
+	for(const ComputeSpec::Buffer &buffer : wanted.buffers)
+	{
+		QByteArray data;
+		if(buffer.generator == "file")
+		{
+			QFile file(QDir(directory).filePath(buffer.file));
+			if(!file.open(QFile::ReadOnly)) { error = "Could not open " + file.fileName(); return false; }
+			data = file.readAll();
+		}
+		else
+		{
+			data = QByteArray(int(buffer.floats * sizeof(GLfloat)), 0);
+			GLfloat *values = reinterpret_cast<GLfloat*>(data.data());
+			std::mt19937 random(1);	// the same "random" data every run, so results can be compared
+			std::uniform_real_distribution<GLfloat> unit(0.0f, 1.0f);
+			if(buffer.generator == "random") for(size_t i = 0; i < buffer.floats; ++i) values[i] = unit(random);
+			else if(buffer.generator == "index") for(size_t i = 0; i < buffer.floats; ++i) values[i] = GLfloat(i);
+			// "zero" is what the array starts out as
+		}
+
+		GLBuffer storage(resources, "compute buffer " + QString::number(buffer.binding));
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, storage);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, data.size(), data.constData(), GL_DYNAMIC_COPY);
+		storage.setSize(data.size());
+		newBuffers.emplace_back(buffer.binding, std::move(storage));
+	}
+
+	std::vector<Image> newImages;
+	for(const ComputeSpec::Image &image : wanted.images)
+	{
+		Image created{image.unit, image.format, GLTexture(resources, "compute image " + QString::number(image.unit))};
+		int width = image.width, height = image.height;
+		QImage pixels;
+		if(!image.file.isEmpty())
+		{
+			if(!pixels.load(QDir(directory).filePath(image.file))) { error = "Could not load " + image.file; return false; }
+			pixels = pixels.convertToFormat(QImage::Format_RGBA8888).mirrored();	// GL starts at the bottom row
+			width = pixels.width();
+			height = pixels.height();
+			created.format = GL_RGBA8;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, created.texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, created.format, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		if(!pixels.isNull())
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.constBits());
+		else	// storage starts out undefined
+		{
+			std::vector<GLfloat> zero(size_t(width) * height * 4, 0.0f);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, created.format == GL_R32F ? GL_RED : GL_RGBA,
+							GL_FLOAT, zero.data());
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		int texel = created.format == GL_RGBA32F ? 16 : created.format == GL_RGBA16F ? 8 : 4;
+		created.texture.setSize(size_t(width) * height * texel);
+		newImages.push_back(std::move(created));
+	}
+
+	GLVertexArray newPoints;
+	GLsizei newPointCount = 0;
+	if(wanted.pointsBinding >= 0)
+	{
+		auto source = std::find_if(newBuffers.begin(), newBuffers.end(),
+								   [&wanted](const std::pair<GLuint, GLBuffer> &b) { return int(b.first) == wanted.pointsBinding; });
+		if(source == newBuffers.end())
+		{
+			error = "There is no buffer " + QString::number(wanted.pointsBinding) + " to draw as points";
+			return false;
+		}
+		GLint bytes = 0;
+		glBindBuffer(GL_ARRAY_BUFFER, source->second);
+		glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &bytes);
+		newPointCount = bytes / GLint(wanted.pointComponents * sizeof(GLfloat));
+
+		newPoints = GLVertexArray(resources, "compute points");
+		glBindVertexArray(newPoints);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, wanted.pointComponents, GL_FLOAT, GL_FALSE, 0, 0);
+		glBindVertexArray(0);
+	}
+
+	// everything was created, swap it in - the old objects are deleted here
+	spec = wanted;
+	program = std::move(built);
+	buffers = std::move(newBuffers);
+	images = std::move(newImages);
+	pointArray = std::move(newPoints);
+	pointCount = newPointCount;
+	gpuTime = 0;
+	for(int i = 0; i < queryCount; ++i)
+	{
+		if(!queries[i]) queries[i] = GLQuery(resources, "compute timer");
+		waiting[i] = false;
+	}
+	return true;
+}
+
+void ComputeStage::dispatch(GLState &state)
+{
+	if(!program) return;
+
+	if(waiting[query])	// the oldest query, issued queryCount frames ago
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(available)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &nanoseconds);
+			gpuTime = nanoseconds / 1e6;
+			waiting[query] = false;
+		}
+	}
+
+	state.useProgram(program);
+	for(const auto &buffer : buffers) state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, buffer.first, buffer.second);
+	for(const Image &image : images)
+		glBindImageTexture(image.unit, image.texture, 0, GL_FALSE, 0, GL_READ_WRITE, image.format);
+
+	bool timed = !waiting[query];	// skip timing this frame rather than wait for the GPU
+	if(timed) glBeginQuery(GL_TIME_ELAPSED, queries[query]);
+	state.dispatchCompute(spec.dispatch[0], spec.dispatch[1], spec.dispatch[2]);
+	if(timed)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		waiting[query] = true;
+	}
+	query = (query + 1) % queryCount;
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+					| GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	// the render pass reads what the dispatch wrote
+}
+
+void ComputeStage::bind(GLState &state, GLuint renderProgram, GLuint firstUnit)
+{
+	for(size_t i = 0; i < images.size(); ++i)
+	{
+		GLuint unit = firstUnit + GLuint(i);
+		state.bindTexture(unit, GL_TEXTURE_2D, images[i].texture);
+		QByteArray name = "computeImage" + QByteArray::number(images[i].unit);
+		state.uniform1i(state.uniformLocation(renderProgram, name.constData()), unit);
+	}
+	// the storage buffers and image units are still bound from the dispatch
+}
+
+void ComputeStage::drawPoints(GLState &state)
+{
+	if(!pointArray || pointCount == 0) return;
+	state.enable(GL_PROGRAM_POINT_SIZE);	// the vertex shader can set gl_PointSize
+	state.bindVertexArray(pointArray);
+	state.drawArrays(GL_POINTS, 0, pointCount);
+}
+
+void ComputeStage::release()
+{
+	program.reset();
+	buffers.clear();
+	images.clear();
+	pointArray.reset();
+	for(GLQuery &q : queries) q.reset();
+	for(bool &w : waiting) w = false;
+	gpuTime = 0;
+}
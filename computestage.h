@@ -0,0 +1,96 @@
+#ifndef COMPUTESTAGE_H
+#define COMPUTESTAGE_H
+
+#include <string>
+#include <vector>
+#include <QString>
+#include <GL/glew.h>
+#include "glresource.h"
+#include "glstate.h"
+
+/** CLARIFICATION:
+ * The compute editor's shader runs once per frame, before the scene is drawn. What it works on is
+ * described by pragmas in its own source, which GL ignores:
+ *
+ * #pragma workgroup 64 1 1				local size, instead of writing the layout(local_size_x...) line
+ * #pragma dispatch 256 1 1				number of workgroups
+ * #pragma buffer 1 random 65536		storage buffer at binding 1 with 65536 floats: zero, random or index
+ * #pragma buffer 2 file data.bin		or filled from a file next to the project
+ * #pragma image 0 rgba32f 512 512		image unit 0, rgba8, rgba16f, rgba32f or r32f
+ * #pragma image 1 file noise.png		or loaded from an image file (rgba8)
+ * #pragma points 1 4					draw buffer 1 as points, 4 floats per point into attribute 0
+ *
+ * Nothing is copied back to the CPU: the buffers stay bound to their storage buffer bindings and the
+ * images to their image units for the render pass, images can be sampled as "computeImage<unit>"
+ * and "points" draws a buffer directly as vertex data. Binding 0 is taken by the scene's model matrices.
+ **/
+
+struct ComputeSpec
+{
+	struct Buffer
+	{
+		GLuint binding = 0;
+		QString generator;	// zero, random, index or file
+		QString file;
+		size_t floats = 0;
+	};
+
+	struct Image
+	{
+		GLuint unit = 0;
+		GLenum format = GL_RGBA8;
+		int width = 0, height = 0;
+		QString file;
+	};
+
+	GLuint workgroup[3] = {0, 0, 0};	// 0 means the shader declares it itself
+	GLuint dispatch[3] = {1, 1, 1};
+	std::vector<Buffer> buffers;
+	std::vector<Image> images;
+	int pointsBinding = -1, pointComponents = 4;
+};
+
+class ComputeStage
+{
+public:
+	explicit ComputeStage(GLResources&);
+
+	static bool supported() { return GLEW_VERSION_4_3; }
+	static bool parse(const std::string &source, ComputeSpec&, QString &error);
+	static std::string withWorkgroup(const std::string &source, const ComputeSpec&);
+
+	// the functions below need the GL context to be current
+	bool setup(GLProgram&&, const ComputeSpec&, const QString &directory, QString &error);
+	void dispatch(GLState&);
+	void bind(GLState&, GLuint program, GLuint firstUnit);
+	void drawPoints(GLState&);
+	void release();
+
+	bool isActive() const { return bool(program); }
+	bool hasImages() const { return !images.empty(); }
+	double milliseconds() const { return gpuTime; }
+
+private:
+	static const int queryCount = 3;	// results are read a few frames late, so the CPU never waits for them
+
+	struct Image
+	{
+		GLuint unit;
+		GLenum format;
+		GLTexture texture;
+	};
+
+	GLResources &resources;
+	ComputeSpec spec;
+	GLProgram program;
+	std::vector<std::pair<GLuint, GLBuffer>> buffers;	// binding and buffer
+	std::vector<Image> images;
+	GLVertexArray pointArray;
+	GLsizei pointCount = 0;
+	GLQuery queries[queryCount];
+	bool waiting[queryCount] = {};
+	int query = 0;
+	double gpuTime = 0;
+};
+
+#endif // COMPUTESTAGE_H
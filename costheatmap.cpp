@@ -0,0 +1,246 @@
+#include "costheatmap.h"
+#include <cctype>
+#include <vector>
+#include <QtGlobal>
+#include "shaderbuild.h"
+
+CostHeatmap::CostHeatmap(GLResources &resources) : resources(resources) {}
+
+static bool identifierCharacter(char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+static size_t skipSpace(const std::string &s, size_t i)	// whitespace and comments
+{
+	while(i < s.size())
+	{
+		if(std::isspace(static_cast<unsigned char>(s[i]))) ++i;
+		else if(s.compare(i, 2, "//") == 0) i = std::min(s.find('\n', i), s.size());
+		else if(s.compare(i, 2, "/*") == 0) i = std::min(s.find("*/", i + 2), s.size() - 2) + 2;
+		else break;
+	}
+	return i;
+}
+
+static size_t closing(const std::string &s, size_t open)	// the ')' that belongs to the '(' at "open"
+{
+	int depth = 0;
+	for(size_t i = open; i < s.size(); ++i)
+	{
+		if(s.compare(i, 2, "//") == 0 || s.compare(i, 2, "/*") == 0) i = skipSpace(s, i) - 1;
+		else if(s[i] == '(') ++depth;
+		else if(s[i] == ')' && --depth == 0) return i;
+	}
+	return std::string::npos;
+}
+
+static std::vector<std::string> splitStatements(const std::string &s)	// a for's "init; condition; step"
+{
+	std::vector<std::string> parts(1);
+	int depth = 0;
+	for(char c : s)
+	{
+		if(c == '(') ++depth;
+		else if(c == ')') --depth;
+		if(c == ';' && depth == 0) parts.emplace_back();
+		else parts.back() += c;
+	}
+	return parts;
+}
+
+static std::string newlines(const std::string &s)	// what's left of removed code, so line numbers don't move
+{
+	std::string kept;
+	for(char c : s) if(c == '\n') kept += c;
+	return kept.empty() ? " " : kept;
+}
+
+static std::string rewrite(const std::string &s, bool global)
+{
+	std::string out;
+	out.reserve(s.size() * 5 / 4);
+	int braces = global ? 0 : 1, parens = 0;
+	bool lineStart = true;
+
+	for(size_t i = 0; i < s.size();)
+	{
+		if(s.compare(i, 2, "//") == 0 || s.compare(i, 2, "/*") == 0 || (s[i] == '#' && lineStart))
+		{
+			size_t end = s[i] == '#' ? std::min(s.find('\n', i), s.size()) : skipSpace(s, i);
+			if(s[i] == '/' && s[i + 1] == '/') end = std::min(s.find('\n', i), s.size());
+			out.append(s, i, end - i);	// comments and preprocessor lines are copied as they are
+			i = end;
+			continue;
+		}
+
+		if(std::isalpha(static_cast<unsigned char>(s[i])) || s[i] == '_')
+		{
+			size_t end = i;
+			while(end < s.size() && identifierCharacter(s[end])) ++end;
+			std::string word = s.substr(i, end - i);
+			size_t next = skipSpace(s, end);
+			bool call = next < s.size() && s[next] == '(';
+			bool outside = braces == 0 && parens == 0;	// global scope, not a parameter list
+			lineStart = false;
+
+			if((word == "if" || word == "while" || word == "for") && call)
+			{
+				size_t close = closing(s, next);
+				if(close != std::string::npos)
+				{
+					std::string inside = rewrite(s.substr(next + 1, close - next - 1), false);
+					out.append(s, i, next - i);
+					std::vector<std::string> parts = splitStatements(inside);
+					if(word != "for") out += "(ideCost(" + inside + "))";
+					else if(parts.size() != 3) out += "(" + inside + ")";
+					else if(skipSpace(parts[1], 0) == parts[1].size())	// for(;;) runs until a break
+						out += "(" + parts[0] + "; ideCost(true)" + parts[1] + ";" + parts[2] + ")";
+					else out += "(" + parts[0] + "; ideCost(" + parts[1] + ");" + parts[2] + ")";
+					i = close + 1;
+					continue;
+				}
+			}
+			else if(word == "layout" && call && outside)	// an output's layout qualifier goes with it
+			{
+				size_t close = closing(s, next);
+				size_t after = close == std::string::npos ? s.size() : skipSpace(s, close + 1);
+				if(s.compare(after, 3, "out") == 0 && (after + 3 == s.size() || !identifierCharacter(s[after + 3])))
+				{
+					out += newlines(s.substr(i, after + 3 - i));
+					i = after + 3;
+					continue;
+				}
+			}
+			else if(word == "out" && outside)	// outputs become plain variables
+			{
+				i = end;
+				continue;
+			}
+			else if(word == "main" && call && outside) word = "ideCostMain";
+			else if(word == "gl_FragColor") word = "ideCostColor";
+
+			out += word;
+			i = end;
+			continue;
+		}
+
+		char c = s[i];
+		if(c == '{') ++braces;
+		else if(c == '}') --braces;
+		else if(c == '(') ++parens;
+		else if(c == ')') --parens;
+		if(c == '\n') lineStart = true;
+		else if(!std::isspace(static_cast<unsigned char>(c))) lineStart = false;
+		out += c;
+		++i;
+	}
+	return out;
+}
+
+std::string CostHeatmap::instrument(const std::string &fragment)
+{
+	return "uint ideCostCounter = 0u;\n"
+		   "bool ideCost(bool taken) { if(taken) ++ideCostCounter; return taken; }\n"
+		   "vec4 ideCostColor;\n"
+		   "layout(location = 0) out float ideCostOutput;\n"
+		   "#line 1\n"
+			+ rewrite(fragment, true) +
+		   "\nvoid main() { ideCostMain(); ideCostOutput = float(ideCostCounter); }\n";
+	// the helpers come first, the new main() last, and the #line keeps the user's code on its own lines
+}
+
+std::string CostHeatmap::overdrawShader()
+{
+	return "layout(location = 0) out float ideOverdraw;\n"
+		   "void main() { ideOverdraw = 1.0; }\n";
+}
+
+void CostHeatmap::create(GLState &state)
+{
+	static const char *vertex =
+			"#version 330 core\n"
+			"out vec2 uv;\n"
+			"void main()\n"
+			"{\n"
+			"	uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+			"	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+			"}\n";	// one triangle that covers the viewport
+	static const char *fragment =
+			"#version 330 core\n"
+			"uniform sampler2D counts;\n"
+			"uniform float scale;\n"
+			"in vec2 uv;\n"
+			"out vec4 color;\n"
+			"void main()\n"
+			"{\n"
+			"	float x = clamp(texture(counts, uv).r / scale, 0.0, 1.0);\n"
+			"	vec3 ramp = clamp(vec3(4.0 * x - 2.0, 2.0 - abs(4.0 * x - 2.0), 2.0 - 4.0 * x), 0.0, 1.0);\n"
+			"	color = vec4(x > 0.0 ? ramp * min(1.0, 0.25 + 4.0 * x) : vec3(0.0), 1.0);\n"
+			"}\n";	// blue over green to red, fading in from black at the low end
+
+	GLShader shaders[2] = { GLShader(resources, "heatmap vertex shader", GL_VERTEX_SHADER),
+							GLShader(resources, "heatmap fragment shader", GL_FRAGMENT_SHADER) };
+	display = GLProgram(resources, "heatmap program");
+	ShaderBuild::compile(shaders[0], vertex);
+	ShaderBuild::compile(shaders[1], fragment);
+	ShaderBuild::link(display, {shaders[0], shaders[1]});
+
+	QString log;
+	bool built = ShaderBuild::compiled(shaders[0], "vertex", log);
+	built = ShaderBuild::compiled(shaders[1], "fragment", log) && built;
+	if(!built || !ShaderBuild::linked(display, log))	// fixed code, so it's a driver problem
+		qWarning("The heatmap display shader didn't build:\n%s", qPrintable(log));
+
+	framebuffer = GLFramebuffer(resources, "heatmap framebuffer");
+	counts = GLTexture(resources, "heatmap counts");
+	emptyArray = GLVertexArray(resources, "heatmap vertex array");
+	state.invalidate();
+}
+
+void CostHeatmap::begin(GLState &state, int w, int h)
+{
+	if(!display) create(state);
+	if(w != width || h != height)
+	{
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, counts);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, w, h, 0, GL_RED, GL_FLOAT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, counts, 0);
+		counts.setSize(size_t(w) * h * sizeof(GLfloat));
+		width = w;
+		height = h;
+		state.invalidate();	// resizing binds behind the state tracker's back
+	}
+
+	state.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	state.disable(GL_DEPTH_TEST);
+	glBlendFunc(GL_ONE, GL_ONE);
+	// every fragment adds its count, whether it's in front or not
+}
+
+void CostHeatmap::end(GLState &state, GLuint target, GLint x, GLint y, GLsizei w, GLsizei h, GLfloat scale)
+{
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);	// back to the GL widget's blending
+	state.bindFramebuffer(GL_FRAMEBUFFER, target);
+	state.viewport(x, y, w, h);
+	state.useProgram(display);
+	state.bindTexture(0, GL_TEXTURE_2D, counts);
+	state.uniform1i(state.uniformLocation(display, "counts"), 0);
+	state.uniform1f(state.uniformLocation(display, "scale"), qMax(scale, 1.0f));
+	state.bindVertexArray(emptyArray);
+	state.drawArrays(GL_TRIANGLES, 0, 3);
+	state.enable(GL_DEPTH_TEST);
+}
+
+void CostHeatmap::release(GLState &state)
+{
+	framebuffer.reset();
+	counts.reset();
+	state.forgetProgram(display);	// GL may hand the name to the next program
+	display.reset();
+	emptyArray.reset();
+	width = height = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef COSTHEATMAP_H
+#define COSTHEATMAP_H
+
+#include <string>
+#include <GL/glew.h>
+#include "glresource.h"
+#include "glstate.h"
+
+/** CLARIFICATION:
+ * Tools > Cost heatmap shows, next to the normal output, where on screen the fragment shader does its work.
+ *
+ * For the shader cost view the fragment shader is rewritten before compiling: every if, while and for
+ * condition goes through ideCost(), which counts it when it's true, so a pixel ends up with the number
+ * of loop iterations and branches it took. The shader's own outputs (and gl_FragColor) become plain
+ * variables, its main() is renamed, and a new main() calls it and writes the count as the only output.
+ * Nothing in the editor changes, the line numbers of compiler errors stay the same, and the built-ins
+ * and samplers work as usual. ?: and switch aren't counted, and discarded fragments count nothing.
+ *
+ * The overdraw view swaps the fragment shader for one that writes 1, so a pixel counts how many
+ * fragments of the scene's meshes covered it.
+ *
+ * Either way the counts are added up in a float framebuffer with depth testing off, so hidden surfaces
+ * count too, and drawn in false colour: black for nothing, then blue, cyan, green, yellow, and red
+ * from the chosen scale upwards.
+ **/
+
+class CostHeatmap
+{
+public:
+	enum Mode { Off, Cost, Overdraw };
+
+	explicit CostHeatmap(GLResources&);
+
+	static std::string instrument(const std::string &fragment);
+	static std::string overdrawShader();
+
+	// the functions below need the GL context to be current
+	void begin(GLState&, int width, int height);
+	void end(GLState&, GLuint framebuffer, GLint x, GLint y, GLsizei width, GLsizei height, GLfloat scale);
+	void release(GLState&);
+
+private:
+	GLResources &resources;
+	GLFramebuffer framebuffer;
+	GLTexture counts;
+	GLProgram display;
+	GLVertexArray emptyArray;	// core profile draws need a vertex array, even without attributes
+	int width = 0, height = 0;
+
+	void create(GLState&);
+};
+
+#endif // COSTHEATMAP_H
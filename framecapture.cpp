@@ -0,0 +1,289 @@
+#include "framecapture.h"
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QDataStream>
+#include <QThread>
+#include <QtEndian>
+#include <vector>
+#include <cstring>
+
+FrameCapture::FrameCapture(GLResources &resources, QObject *parent) : QObject(parent), resources(resources)
+{
+	pool.setMaxThreadCount(QThread::idealThreadCount());	// one encoder per core
+	maxPending = 2*pool.maxThreadCount();
+}
+
+qint64 FrameCapture::frameBytes(const CaptureSettings &s)
+{
+	return qint64(s.width)*s.height*(s.exr ? 8 : 4);	// RGBA8 or RGBA16F
+}
+
+void FrameCapture::start(const CaptureSettings &s)
+{
+	if(active) stop();
+	settings = s;
+	if(frameBytes() > maxFrameBytes)	// the dialog doesn't allow it, but settings can come from elsewhere
+	{
+		emit finished("Capture failed: a " + QString::number(settings.width) + "x" + QString::number(settings.height)
+					  + " frame doesn't fit in one readback buffer.");
+		return;
+	}
+	QDir().mkpath(settings.directory);
+
+	framebuffer = GLFramebuffer(resources, "capture framebuffer");
+	colorBuffer = GLRenderbuffer(resources, "capture color");
+	depthBuffer = GLRenderbuffer(resources, "capture depth");
+	colorBuffer.setSize(size_t(frameBytes()));
+	depthBuffer.setSize(size_t(settings.width)*settings.height*4);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, settings.exr ? GL_RGBA16F : GL_RGBA8,
+						  settings.width, settings.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, settings.width, settings.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	// offscreen target of the requested size, it doesn't have to match the window
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for(auto &slot : ring)
+	{
+		slot.pbo = GLBuffer(resources, "capture readback");
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes(), nullptr, GL_STREAM_READ);
+		slot.pbo.setSize(frameBytes());
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	// pixel buffers that glReadPixels writes into without waiting for the GPU
+
+	head = used = nextFrame = 0;
+	encoded = std::make_shared<std::atomic<int>>(0);
+	pending = std::make_shared<std::atomic<int>>(0);
+	failed = std::make_shared<std::atomic<int>>(0);
+	active = true;
+
+	if(!complete)
+	{
+		release();
+		emit finished("Capture failed: the driver could not create a "
+					  + QString::number(settings.width) + "x" + QString::number(settings.height)
+					  + " framebuffer.");
+	}
+}
+
+void FrameCapture::stop()
+{
+	if(!active) return;
+	release();
+	emit finished("Capture stopped after " + QString::number(encoded->load()) + " frames.");
+	// frames already handed to the encoders are still written
+}
+
+void FrameCapture::release()
+{
+	for(auto &slot : ring)
+	{
+		if(slot.fence) glDeleteSync(slot.fence);
+		slot = Slot();	// deletes the pixel buffer
+	}
+	colorBuffer.reset();
+	depthBuffer.reset();
+	framebuffer.reset();
+	active = false;
+}
+
+void FrameCapture::collect()
+{
+	/** CLARIFICATION:
+	 * Readbacks complete in the order they were issued, so only the oldest slot has to be checked.
+	 * A zero timeout makes glClientWaitSync a poll - if the GPU hasn't finished that frame yet,
+	 * we simply try again on the next tick instead of stalling the render loop.
+	 **/
+
+	while(used > 0 && pending->load() < maxPending)
+	{
+		Slot &slot = ring[head];
+		GLenum state = glClientWaitSync(slot.fence, 0, 0);
+		if(state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED) break;
+
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+
+		QByteArray pixels(int(frameBytes()), Qt::Uninitialized);	// at most maxFrameBytes
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes(), GL_MAP_READ_BIT);
+		if(data)
+		{
+			memcpy(pixels.data(), data, frameBytes());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		// copy the frame out of the PBO so the slot can be reused right away
+
+		QString path = QDir(settings.directory).filePath(
+					QString("%1_%2.%3").arg(settings.baseName).arg(slot.frame, 5, 10, QChar('0'))
+					.arg(settings.exr ? "exr" : "png"));
+		if(data)
+		{
+			++*pending;
+			pool.start(new EncodeTask(pixels, settings.width, settings.height, settings.exr, path,
+									  encoded, pending, failed));
+			// flipping and encoding happen on the pool, never on the GUI thread
+		}
+		else ++*failed;
+
+		head = (head + 1) % ringSize;
+		--used;
+	}
+}
+
+void FrameCapture::process(const std::function<void(GLfloat, int, int)> &draw, GLuint restoreFramebuffer)
+{
+	if(!active) return;
+
+	collect();
+
+	bool issued = false;
+	while(used < ringSize && nextFrame < settings.frameCount && pending->load() < maxPending)
+	{
+		Slot &slot = ring[(head + used) % ringSize];
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		draw(settings.startTime + nextFrame*settings.timeStep, settings.width, settings.height);
+		// render at the fixed timestep, independently of the preview's own clock
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, settings.width, settings.height, GL_RGBA,
+					 settings.exr ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE, 0);
+		// with a pack buffer bound this only queues the copy, it doesn't wait for the frame
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.frame = nextFrame++;
+		++used;
+		issued = true;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, restoreFramebuffer);
+	if(issued) glFlush();	// make sure the fences actually reach the GPU
+
+	emit progress(encoded->load(), settings.frameCount);
+
+	if(nextFrame == settings.frameCount && used == 0 && pending->load() == 0)
+	{
+		int errors = failed->load();
+		QString message = "Captured " + QString::number(encoded->load()) + " frames to "
+				+ settings.directory;
+		if(errors > 0) message += " (" + QString::number(errors) + " frames could not be written)";
+		release();
+		emit finished(message);
+	}
+}
+
+FrameCapture::~FrameCapture()
+{
+	pool.waitForDone();	// GL resources are released by the owner while its context is current
+}
+
+EncodeTask::EncodeTask(QByteArray pixels, int width, int height, bool exr, QString path,
+					   std::shared_ptr<std::atomic<int>> encoded,
+					   std::shared_ptr<std::atomic<int>> pending,
+					   std::shared_ptr<std::atomic<int>> failed)
+	: pixels(pixels), width(width), height(height), exr(exr), path(path),
+	  encoded(encoded), pending(pending), failed(failed) {}
+
+void EncodeTask::run()
+{
+	bool ok;
+	if(exr)
+		ok = writeEXR(path, reinterpret_cast<const unsigned short*>(pixels.constData()), width, height);
+	else
+	{
+		QImage image(reinterpret_cast<const uchar*>(pixels.constData()), width, height,
+					 QImage::Format_RGBA8888);
+		ok = image.mirrored().save(path, "PNG");	// GL rows start at the bottom, so flip
+	}
+	if(ok) ++*encoded;
+	else ++*failed;
+	--*pending;
+}
+
+bool EncodeTask::writeEXR(const QString &path, const unsigned short *rgba, int width, int height)
+{
+	/** CLARIFICATION:
+	 * Qt can't write OpenEXR, so this writes the simplest valid variant of the format by hand:
+	 * a single-part scanline file with uncompressed half-float A, B, G and R channels
+	 * (channels have to be stored in alphabetical order), one scanline per block.
+	 **/
+
+	QFile file(path);
+	if(!file.open(QFile::WriteOnly)) return false;
+	QDataStream out(&file);
+	out.setByteOrder(QDataStream::LittleEndian);
+	out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+	auto attribute = [&](const char *name, const char *type, qint32 size)
+	{
+		out.writeRawData(name, int(strlen(name)) + 1);
+		out.writeRawData(type, int(strlen(type)) + 1);
+		out << size;
+	};
+
+	out << quint32(20000630) << quint32(2);	// magic number and version
+
+	const char channels[] = "ABGR";
+	attribute("channels", "chlist", 4*18 + 1);
+	for(int c = 0; c < 4; ++c)
+	{
+		out.writeRawData(&channels[c], 1);
+		out << quint8(0);	// end of channel name
+		out << qint32(1);	// HALF
+		out << quint8(0) << quint8(0) << quint8(0) << quint8(0);	// pLinear and reserved
+		out << qint32(1) << qint32(1);	// x and y sampling
+	}
+	out << quint8(0);
+
+	attribute("compression", "compression", 1);
+	out << quint8(0);	// NO_COMPRESSION
+	attribute("dataWindow", "box2i", 16);
+	out << qint32(0) << qint32(0) << qint32(width - 1) << qint32(height - 1);
+	attribute("displayWindow", "box2i", 16);
+	out << qint32(0) << qint32(0) << qint32(width - 1) << qint32(height - 1);
+	attribute("lineOrder", "lineOrder", 1);
+	out << quint8(0);	// INCREASING_Y
+	attribute("pixelAspectRatio", "float", 4);
+	out << 1.0f;
+	attribute("screenWindowCenter", "v2f", 8);
+	out << 0.0f << 0.0f;
+	attribute("screenWindowWidth", "float", 4);
+	out << 1.0f;
+	out << quint8(0);	// end of header
+
+	const qint32 lineBytes = width*4*2;
+	quint64 offset = quint64(file.pos()) + quint64(height)*8;
+	for(int y = 0; y < height; ++y)
+	{
+		out << offset;
+		offset += 8 + lineBytes;
+	}
+	// offset table - every scanline block is its y coordinate, its size and the pixel data
+
+	const int order[4] = {3, 2, 1, 0};	// A, B, G, R from RGBA
+	std::vector<unsigned short> line(width*4);
+	for(int y = 0; y < height; ++y)
+	{
+		const unsigned short *row = rgba + size_t(height - 1 - y)*width*4;	// flip while writing
+		for(int c = 0; c < 4; ++c)
+			for(int x = 0; x < width; ++x)
+				line[c*width + x] = qToLittleEndian(row[x*4 + order[c]]);
+		out << qint32(y) << lineBytes;
+		out.writeRawData(reinterpret_cast<const char*>(line.data()), lineBytes);
+	}
+
+	return out.status() == QDataStream::Ok && file.error() == QFile::NoError;
+}
@@ -0,0 +1,93 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QThreadPool>
+#include <QRunnable>
+#include <GL/glew.h>
+#include "glresource.h"
+
+struct CaptureSettings
+{
+	QString directory;	// folder the image sequence is written to
+	QString baseName = "frame";
+	int width = 1920, height = 1080;	// offscreen resolution, independent of the window
+	int frameCount = 100;
+	GLfloat startTime = 0.0f;
+	GLfloat timeStep = 1.0f/60.0f;	// fixed timestep between captured frames
+	bool exr = false;	// write half-float .exr instead of 8-bit .png
+};
+
+class FrameCapture : public QObject
+{
+	Q_OBJECT
+public:
+	explicit FrameCapture(GLResources&, QObject *parent = nullptr);
+	~FrameCapture();
+
+	bool isActive() const { return active; }
+
+	static qint64 frameBytes(const CaptureSettings&);
+	static const qint64 maxFrameBytes = qint64(1) << 30;	// one frame has to fit in a pixel buffer and a QByteArray
+
+	// the functions below need the GL context to be current
+	void start(const CaptureSettings&);
+	void stop();
+	void process(const std::function<void(GLfloat, int, int)> &draw, GLuint restoreFramebuffer);
+
+private:
+	static const int ringSize = 4;	// frames that can be in flight between GL and the CPU
+
+	struct Slot
+	{
+		GLBuffer pbo;
+		GLsync fence = 0;
+		int frame = -1;
+	};
+
+	GLResources &resources;
+	CaptureSettings settings;
+	bool active = false;
+	Slot ring[ringSize];
+	int head = 0, used = 0;	// oldest slot in the ring and number of slots awaiting readback
+	int nextFrame = 0;	// next frame to be rendered
+	int maxPending;	// upper bound on frames waiting for the encoder, limits memory use
+	GLFramebuffer framebuffer;
+	GLRenderbuffer colorBuffer, depthBuffer;
+	QThreadPool pool;
+	std::shared_ptr<std::atomic<int>> encoded, pending, failed;
+
+	qint64 frameBytes() const { return frameBytes(settings); }
+	void collect();
+	void release();
+
+signals:
+	void progress(int, int);
+	void finished(QString);
+};
+
+class EncodeTask : public QRunnable
+{
+public:
+	EncodeTask(QByteArray pixels, int width, int height, bool exr, QString path,
+			   std::shared_ptr<std::atomic<int>> encoded,
+			   std::shared_ptr<std::atomic<int>> pending,
+			   std::shared_ptr<std::atomic<int>> failed);
+	void run();
+
+	static bool writeEXR(const QString&, const unsigned short*, int, int);
+
+private:
+	QByteArray pixels;
+	int width, height;
+	bool exr;
+	QString path;
+	std::shared_ptr<std::atomic<int>> encoded, pending, failed;
+};
+
+#endif // FRAMECAPTURE_H
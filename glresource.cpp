@@ -0,0 +1,84 @@
+#include "glresource.h"
+#include <QtGlobal>
+
+const char *GLResources::kindName(Kind kind)
+{
+	static const char *names[KindCount] =
+	{
+		"buffer", "texture", "renderbuffer", "framebuffer", "vertex array", "shader", "program", "query"
+	};
+	return names[kind];
+}
+
+GLuint GLResources::create(Kind kind, const QString &label, GLenum shaderType)
+{
+	GLuint name = 0;
+	switch(kind)
+	{
+	case Buffer: glGenBuffers(1, &name); break;
+	case Texture: glGenTextures(1, &name); break;
+	case Renderbuffer: glGenRenderbuffers(1, &name); break;
+	case Framebuffer: glGenFramebuffers(1, &name); break;
+	case VertexArray: glGenVertexArrays(1, &name); break;
+	case Shader: name = glCreateShader(shaderType); break;
+	case Program: name = glCreateProgram(); break;
+	case Query: glGenQueries(1, &name); break;
+	default: break;
+	}
+	if(name == 0) return 0;	// creation failed, most likely no current context
+
+	Entry &entry = entries[std::make_pair(kind, name)];
+	entry.label = label;
+	++counts[kind];
+	return name;
+}
+
+void GLResources::destroy(Kind kind, GLuint name)
+{
+	switch(kind)
+	{
+	case Buffer: glDeleteBuffers(1, &name); break;
+	case Texture: glDeleteTextures(1, &name); break;
+	case Renderbuffer: glDeleteRenderbuffers(1, &name); break;
+	case Framebuffer: glDeleteFramebuffers(1, &name); break;
+	case VertexArray: glDeleteVertexArrays(1, &name); break;
+	case Shader: glDeleteShader(name); break;
+	case Program: glDeleteProgram(name); break;
+	case Query: glDeleteQueries(1, &name); break;
+	default: break;
+	}
+
+	auto entry = entries.find(std::make_pair(kind, name));
+	if(entry == entries.end()) return;
+	bytes[kind] -= entry->second.bytes;
+	totalBytes -= entry->second.bytes;
+	--counts[kind];
+	entries.erase(entry);
+}
+
+void GLResources::setSize(Kind kind, GLuint name, size_t size)
+{
+	auto entry = entries.find(std::make_pair(kind, name));
+	if(entry == entries.end()) return;
+	bytes[kind] += size - entry->second.bytes;
+	totalBytes += size - entry->second.bytes;
+	entry->second.bytes = size;
+	// sizes are the memory the data needs, the driver may round up or keep extra copies
+}
+
+QStringList GLResources::live() const
+{
+	QStringList list;
+	for(const auto &entry : entries)
+		list.append(QString("%1 %2 \"%3\" (%4 bytes)").arg(kindName(entry.first.first)).arg(entry.first.second)
+					.arg(entry.second.label).arg(entry.second.bytes));
+	return list;
+}
+
+void GLResources::reportLeaks() const
+{
+	if(entries.empty()) return;
+	qWarning("%d GL objects (%zu bytes) were not deleted before the context was destroyed:",
+			 int(entries.size()), totalBytes);
+	for(const QString &leak : live()) qWarning("  %s", qPrintable(leak));
+}
@@ -0,0 +1,97 @@
+#ifndef GLRESOURCE_H
+#define GLRESOURCE_H
+
+#include <map>
+#include <utility>
+#include <QString>
+#include <QStringList>
+#include <GL/glew.h>
+
+/** CLARIFICATION:
+ * Every GL object the IDE creates goes through a GLResources registry, which remembers its kind,
+ * what it is used for and how much memory it holds. The objects are owned by GLHandle, which deletes
+ * them when it goes out of scope or gets a new object moved into it, so an object can't be forgotten
+ * on an error path. Whatever is still registered when the context is torn down is a leak, and gets reported.
+ **/
+
+class GLResources
+{
+public:
+	enum Kind { Buffer, Texture, Renderbuffer, Framebuffer, VertexArray, Shader, Program, Query, KindCount };
+
+	static const char *kindName(Kind);
+
+	// the functions below need the GL context to be current
+	GLuint create(Kind, const QString &label, GLenum shaderType = 0);
+	void destroy(Kind, GLuint);
+
+	void setSize(Kind, GLuint, size_t bytes);
+	size_t liveBytes() const { return totalBytes; }
+	size_t liveBytes(Kind kind) const { return bytes[kind]; }
+	int liveCount(Kind kind) const { return counts[kind]; }
+	QStringList live() const;
+	void reportLeaks() const;
+
+private:
+	struct Entry
+	{
+		QString label;
+		size_t bytes = 0;
+	};
+
+	std::map<std::pair<Kind, GLuint>, Entry> entries;
+	size_t bytes[KindCount] = {};
+	int counts[KindCount] = {};
+	size_t totalBytes = 0;
+};
+
+template<GLResources::Kind K>
+class GLHandle
+{
+public:
+	GLHandle() {}
+	GLHandle(GLResources &registry, const QString &label, GLenum shaderType = 0)
+		: registry(&registry), name(registry.create(K, label, shaderType)) {}
+	~GLHandle() { reset(); }
+
+	GLHandle(const GLHandle&) = delete;
+	GLHandle &operator=(const GLHandle&) = delete;
+	GLHandle(GLHandle &&other) : registry(other.registry), name(other.name) { other.name = 0; }
+	GLHandle &operator=(GLHandle &&other)
+	{
+		if(this != &other)
+		{
+			reset();
+			registry = other.registry;
+			name = other.name;
+			other.name = 0;
+		}
+		return *this;
+	}
+
+	GLuint id() const { return name; }
+	operator GLuint() const { return name; }
+	explicit operator bool() const { return name != 0; }
+
+	void setSize(size_t bytes) { if(name) registry->setSize(K, name, bytes); }
+	void reset()
+	{
+		if(name) registry->destroy(K, name);
+		name = 0;
+	}
+
+private:
+	GLResources *registry = nullptr;
+	GLuint name = 0;
+};
+
+typedef GLHandle<GLResources::Buffer> GLBuffer;
+typedef GLHandle<GLResources::Texture> GLTexture;
+typedef GLHandle<GLResources::Renderbuffer> GLRenderbuffer;
+typedef GLHandle<GLResources::Framebuffer> GLFramebuffer;
+typedef GLHandle<GLResources::VertexArray> GLVertexArray;
+typedef GLHandle<GLResources::Shader> GLShader;
+typedef GLHandle<GLResources::Program> GLProgram;
+typedef GLHandle<GLResources::Query> GLQuery;
+
+#endif // GLRESOURCE_H
@@ -0,0 +1,109 @@
+#include "glslfile.h"
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <QRegularExpression>
+#include <QFileInfo>
+#include <QDir>
+
+bool GLSLFile::read(const QString &path)
+{
+	QFile file(path); // get file handle
+	if(!file.open(QFile::ReadOnly)) return false; // see if file can be opened properly
+
+	vertex.clear();
+	fragment.clear();
+	compute.clear();
+
+	QTextStream inputStream(&file); // get file contents
+	if(inputStream.readLine() != "GLSL_FILE") return false; // check if file is a valid IDE-formatted file
+
+	QStringList *section = nullptr;
+	QStringList vertexLines, fragmentLines, computeLines;
+	while(!inputStream.atEnd())
+	{
+		QString line = inputStream.readLine();
+		if(section == nullptr)	// between sections, only look for the next section header
+		{
+			if(line == "VERTEX_SHADER_BEGIN") section = &vertexLines;
+			else if(line == "FRAGMENT_SHADER_BEGIN") section = &fragmentLines;
+			else if(line == "COMPUTE_SHADER_BEGIN") section = &computeLines;
+		}
+		else if(line == "VERTEX_SHADER_END" || line == "FRAGMENT_SHADER_END" || line == "COMPUTE_SHADER_END") section = nullptr;
+		else section->append(line);
+	}
+	vertex = vertexLines.join('\n');
+	fragment = fragmentLines.join('\n');
+	compute = computeLines.join('\n');
+	return true;
+}
+
+bool GLSLFile::write(const QString &path) const
+{
+	QFile file(path);
+	if(!file.open(QFile::WriteOnly)) return false;
+
+	QTextStream outputStream(&file);
+	outputStream << "GLSL_FILE\n";
+	outputStream << "VERTEX_SHADER_BEGIN\n";
+	outputStream << vertex;
+	outputStream << "\nVERTEX_SHADER_END\n\n";
+	outputStream << "FRAGMENT_SHADER_BEGIN\n";
+	outputStream << fragment;
+	outputStream << "\nFRAGMENT_SHADER_END\n\n";
+	if(!compute.trimmed().isEmpty())	// older versions can still open projects without one
+	{
+		outputStream << "COMPUTE_SHADER_BEGIN\n";
+		outputStream << compute;
+		outputStream << "\nCOMPUTE_SHADER_END\n\n";
+	}
+	outputStream.flush();	// a full disk only shows up once the buffer reaches the file
+	return outputStream.status() == QTextStream::Ok && file.error() == QFile::NoError;
+}
+
+static bool expand(QString &source, const QString &directory, QStringList &included, QStringList &stack,
+				   int sourceNumber, QString &error)
+{
+	static const QRegularExpression directive("^\\s*#\\s*include\\s+\"([^\"]+)\"\\s*$");
+
+	QStringList lines = source.split('\n');
+	for(int i = 0; i < lines.size(); ++i)
+	{
+		QRegularExpressionMatch match = directive.match(lines[i]);
+		if(!match.hasMatch()) continue;
+
+		QString path = QFileInfo(QDir(directory), match.captured(1)).absoluteFilePath();
+		if(stack.contains(path))
+		{
+			error = "Recursive #include of " + path;
+			return false;
+		}
+
+		QFile file(path);
+		if(!file.open(QFile::ReadOnly | QFile::Text))
+		{
+			error = "Could not open #include \"" + match.captured(1) + "\" (line " + QString::number(i + 1) + ")";
+			return false;
+		}
+		QString code = QTextStream(&file).readAll();
+
+		if(!included.contains(path)) included.append(path);
+		int number = included.indexOf(path) + 1;
+		stack.append(path);
+		bool expanded = expand(code, QFileInfo(path).absolutePath(), included, stack, number, error);
+		stack.removeLast();
+		if(!expanded) return false;
+
+		lines[i] = "#line 1 " + QString::number(number) + "\n" + code + "\n#line "
+				+ QString::number(i + 2) + " " + QString::number(sourceNumber);
+		// the line after the directive continues with its own number in its own source string
+	}
+	source = lines.join('\n');
+	return true;
+}
+
+bool GLSLFile::expandIncludes(QString &source, const QString &directory, QStringList &included, QString &error)
+{
+	QStringList stack;
+	return expand(source, directory, included, stack, 0, error);
+}
@@ -0,0 +1,38 @@
+#ifndef GLSLFILE_H
+#define GLSLFILE_H
+
+#include <QString>
+#include <QStringList>
+
+/** CLARIFICATION:
+ * A .glsl project file keeps all shader stages in one text file:
+ *
+ * GLSL_FILE
+ * VERTEX_SHADER_BEGIN
+ * ...
+ * VERTEX_SHADER_END
+ *
+ * FRAGMENT_SHADER_BEGIN
+ * ...
+ * FRAGMENT_SHADER_END
+ *
+ * COMPUTE_SHADER_BEGIN				optional, only written when the compute editor has code
+ * ...
+ * COMPUTE_SHADER_END
+ *
+ * Any stage can pull in shared code with #include "file", relative to the project's folder.
+ * The included code is pasted in place with #line directives around it, so compiler errors point at
+ * the right line: source string 0 is the editor, source string n is the n-th file in "included".
+ **/
+
+struct GLSLFile
+{
+	QString vertex, fragment, compute;
+
+	bool read(const QString&);
+	bool write(const QString&) const;
+
+	static bool expandIncludes(QString &source, const QString &directory, QStringList &included, QString &error);
+};
+
+#endif // GLSLFILE_H
@@ -2,106 +2,80 @@
 
 GLSLSyntax::GLSLSyntax(QTextDocument *parent) : QSyntaxHighlighter(parent)
 {
-	keywordFormat.setForeground(Qt::darkBlue);	// color of text to be highlighted
-	keywordFormat.setFontWeight(QFont::Bold);	// font weight of text to be highlighted
-	QStringList keywordPatterns;
-	keywordPatterns << "\\battribute\\b" << "\\bconst\\b" << "\\buniform\\b"
-					<< "\\bvarying\\b" << "\\blayout\\b" << "\\bcentroid\\b"
-					<< "\\bflat\\b" << "\\bsmooth\\b" << "\\bnoperspective\\b"
-					<< "\\bcontinue\\b" << "\\bbreak\\b" << "\\bdo\\b"
-					<< "\\bfor\\b" << "\\bwhile\\b" << "\\bswitch\\b"
-					<< "\\bcase\\b" << "\\bdefault\\b" << "\\bif\\b"
-					<< "\\belse\\b" << "\\bin\\b" << "\\bout\\b"
-					<< "\\binout\\b" << "\\bfloat\\b" << "\\bint\\b"
-					<< "\\bvoid\\b" << "\\bbool\\b" << "\\btrue\\b"
-					<< "\\bfalse\\b" << "\\binvariant\\b" << "\\bdiscard\\b"
-					<< "\\breturn\\b" << "\\bmat2\\b" << "\\bmat3\\b"
-					<< "\\bmat4\\b" << "\\bmat2x2\\b" << "\\bmat3x3\\b"
-					<< "\\bmat4x4\\b" << "\\bmat2x3\\b" << "\\bmat2x4\\b"
-					<< "\\bmat3x2\\b" << "\\bmat3x4\\b" << "\\bmat4x2\\b"
-					<< "\\bmat4x3\\b" << "\\bvec2\\b" << "\\bvec3\\b"
-					<< "\\bvec4\\b" << "\\bivec2\\b" << "\\bivec3\\b"
-					<< "\\bivec4\\b" << "\\bbvec2\\b" << "\\bbvec3\\b"
-					<< "\\bbvec4\\b" << "\\buint\\b" << "\\buvec2\\b"
-					<< "\\buvec3\\b" << "\\buvec4\\b" << "\\blowp\\b"
-					<< "\\bmediump\\b" << "\\bhighp\\b" << "\\bprecision\\b"
-					<< "\\bsampler1D\\b" << "\\bsampler2D\\b" << "\\bsampler3D\\b"
-					<< "\\bsamplerCube\\b" << "\\bsampler1DShadow\\b" << "\\bsampler2DShadow\\b"
-					<< "\\bsamplerCubeShadow\\b" << "\\bsampler1DArray\\b" << "\\bsampler2DArray\\b"
-					<< "\\bsampler1DArrayShadow\\b" << "\\bsampler2DArrayShadow\\b"
-					<< "\\bisampler1D\\b" << "\\bisampler2D\\b" << "\\bisampler3D\\b"
-					<< "\\bisamplerCube\\b" << "\\bisampler1DArray\\b" << "\\bisampler2DArray\\b"
-					<< "\\busampler1D\\b" << "\\busampler2D\\b" << "\\busampler3D\\b"
-					<< "\\busamplerCube\\b" << "\\busampler1DArray\\b" << "\\busampler2DArray\\b"
-					<< "\\bsampler2DRect\\b" << "\\bsampler2DRectShadow\\b" << "\\bisampler2DRect\\b"
-					<< "\\busampler2DRect\\b" << "\\bsamplerBuffer\\b" << "\\bisamplerBuffer\\b"
-					<< "\\busamplerBuffer\\b" << "\\bsampler2DMS\\b" << "\\bisampler2DMS\\b"
-					<< "\\busampler2DMS\\b" << "\\bsampler2DMSArray\\b" << "\\bisampler2DMSArray\\b"
-					<< "\\busampler2DMSArray\\b" << "\\bstruct\\b";
-	// list of keywords to be highlighted and the way in which to highlight them (bold in this case)
+	rules();	// the first editor builds the rules, every other one reuses them
+}
 
-	// rinse and repeat:
-	functionFormat.setForeground(Qt::darkMagenta);
-	functionFormat.setFontWeight(QFont::Bold);
-	QStringList functionPatterns;
-	functionPatterns << "\\bradians\\b" << "\\bdegrees\\b" << "\\bsin\\b"
-					 << "\\bcos\\b" << "\\btan\\b" << "\\basin\\b"
-					 << "\\bacos\\b" << "\\batan\\b" << "\\bsinh\\b"
-					 << "\\bcosh\\b" << "\\btanh\\b" << "\\basinh\\b"
-					 << "\\bacosh\\b" << "\\batanh\\b" << "\\bpow\\b"
-					 << "\\bexp\\b" << "\\blog\\b" << "\\bexp2\\b"
-					 << "\\blog2\\b" << "\\bsqrt\\b" << "\\binversesqrt\\b"
-					 << "\\babs\\b" << "\\bsign\\b" << "\\bfloor\\b"
-					 << "\\btrunc\\b" << "\\bround\\b" << "\\broundEven\\b"
-					 << "\\bceil\\b" << "\\bfract\\b" << "\\bmod\\b"
-					 << "\\bmodf\\b" << "\\bmin\\b" << "\\bmax\\b"
-					 << "\\bclamp\\b" << "\\bmix\\b" << "\\bstep\\b"
-					 << "\\bsmoothstep\\b" << "\\bisnan\\b" << "\\bisinf\\b"
-					 << "\\bfloatBitsToInt\\b" << "\\bfloatBitsToUint\\b" << "\\bintBitsToFloat\\b"
-					 << "\\buintBitsToFloat\\b" << "\\blength\\b" << "\\bdistance\\b"
-					 << "\\bdot\\b" << "\\bcross\\b" << "\\bnormalize\\b"
-					 << "\\bftransform\\b" << "\\bfaceforward\\b" << "\\breflect\\b"
-					 << "\\brefract\\b" << "\\bmatrixCompMult\\b" << "\\bouterProduct\\b"
-					 << "\\btranspose\\b" << "\\bdeterminant\\b" << "\\binverse\\b"
-					 << "\\blessThan\\b" << "\\blessThanEqual\\b" << "\\bgreaterThan\\b"
-					 << "\\bgreaterThanEqual\\b" << "\\bequal\\b" << "\\bnotEqual\\b"
-					 << "\\bany\\b" << "\\ball\\b" << "\\bnot\\b"
-					 << "\\btextureSize\\b" << "\\btexture\\b" << "\\btextureProj\\b"
-					 << "\\btextureLod\\b" << "\\btextureOffset\\b" << "\\btexelFetch\\b"
-					 << "\\btexelFetchOffset\\b" << "\\btextureProjOffset\\b" << "\\btextureLodOffset\\b"
-					 << "\\btextureProjLod\\b" << "\\btextureProjLodOffset\\b" << "\\btextureGrad\\b"
-					 << "\\btextureGradOffset\\b" << "\\btextureProjGrad\\b" << "\\btextureProjGradOffset\\b"
-					 << "\\btexture1D\\b" << "\\btexture1DLod\\b" << "\\btexture1DProj\\b"
-					 << "\\btexture1DProjLod\\b" << "\\btexture2D\\b" << "\\btexture2DLod\\b"
-					 << "\\btexture2DProj\\b" << "\\btexture2DProjLod\\b" << "\\btexture3D\\b"
-					 << "\\btexture3DLod\\b" << "\\btexture3DProj\\b" << "\\btexture3DProjLod\\b"
-					 << "\\btextureCube\\b" << "\\btextureCubeLod\\b"
-					 << "\\bshadow1D\\b" << "\\bshadow1DLod\\b" << "\\bshadow1DProj\\b"
-					 << "\\bshadow1DProjLod\\b" << "\\bshadow2D\\b" << "\\bshadow2DLod\\b"
-					 << "\\bshadow2DProj\\b" << "\\bshadow2DProjLod\\b" << "\\bdFdx\\b"
-					 << "\\bdFdy\\b" << "\\bfwidth\\b" << "\\bnoise1\\b"
-					 << "\\bnoise2\\b"<< "\\bnoise3\\b" << "\\bnoise4\\b";
+const QVector<GLSLSyntax::Rule> &GLSLSyntax::rules()
+{
+	/** CLARIFICATION:
+	 * Every word list becomes a single "\b(?:word|word|...)\b" expression, so a line is searched twice instead of
+	 * once per word (there are more than 200 of them), and the expressions are compiled once for the whole
+	 * program instead of once per editor. optimize() compiles them right here, not on the first keystroke.
+	 **/
 
-	foreach(const QString &pattern, keywordPatterns)
+	static const QVector<Rule> table = []()
 	{
-		Rule tempRule;
-		tempRule.wordFormat = keywordFormat;	// make format for highlighting
-		tempRule.regexp = QRegularExpression(pattern);	// make regular expressions from list above
-		keywordRules.append(tempRule);	// add rule to the vector of rules
-	}
+		QTextCharFormat keywordFormat;
+		keywordFormat.setForeground(Qt::darkBlue);	// color of text to be highlighted
+		keywordFormat.setFontWeight(QFont::Bold);	// font weight of text to be highlighted
+		QTextCharFormat functionFormat;
+		functionFormat.setForeground(Qt::darkMagenta);
+		functionFormat.setFontWeight(QFont::Bold);
 
-	foreach(const QString &pattern, functionPatterns)
-	{
-		Rule tempRule;
-		tempRule.wordFormat = functionFormat;
-		tempRule.regexp = QRegularExpression(pattern);
-		functionRules.append(tempRule);
-	}
+		QStringList keywords;
+		keywords << "attribute" << "const" << "uniform" << "varying" << "layout" << "centroid"
+				<< "flat" << "smooth" << "noperspective" << "continue" << "break" << "do"
+				<< "for" << "while" << "switch" << "case" << "default" << "if"
+				<< "else" << "in" << "out" << "inout" << "float" << "int"
+				<< "void" << "bool" << "true" << "false" << "invariant" << "discard"
+				<< "return" << "mat2" << "mat3" << "mat4" << "mat2x2" << "mat3x3"
+				<< "mat4x4" << "mat2x3" << "mat2x4" << "mat3x2" << "mat3x4" << "mat4x2"
+				<< "mat4x3" << "vec2" << "vec3" << "vec4" << "ivec2" << "ivec3"
+				<< "ivec4" << "bvec2" << "bvec3" << "bvec4" << "uint" << "uvec2"
+				<< "uvec3" << "uvec4" << "lowp" << "mediump" << "highp" << "precision"
+				<< "sampler1D" << "sampler2D" << "sampler3D" << "samplerCube" << "sampler1DShadow" << "sampler2DShadow"
+				<< "samplerCubeShadow" << "sampler1DArray" << "sampler2DArray" << "sampler1DArrayShadow" << "sampler2DArrayShadow" << "isampler1D"
+				<< "isampler2D" << "isampler3D" << "isamplerCube" << "isampler1DArray" << "isampler2DArray" << "usampler1D"
+				<< "usampler2D" << "usampler3D" << "usamplerCube" << "usampler1DArray" << "usampler2DArray" << "sampler2DRect"
+				<< "sampler2DRectShadow" << "isampler2DRect" << "usampler2DRect" << "samplerBuffer" << "isamplerBuffer" << "usamplerBuffer"
+				<< "sampler2DMS" << "isampler2DMS" << "usampler2DMS" << "sampler2DMSArray" << "isampler2DMSArray" << "usampler2DMSArray"
+				<< "struct";
+		// keywords to be highlighted and the way in which to highlight them (bold in this case)
+
+		QStringList functions;
+		functions << "radians" << "degrees" << "sin" << "cos" << "tan" << "asin"
+				<< "acos" << "atan" << "sinh" << "cosh" << "tanh" << "asinh"
+				<< "acosh" << "atanh" << "pow" << "exp" << "log" << "exp2"
+				<< "log2" << "sqrt" << "inversesqrt" << "abs" << "sign" << "floor"
+				<< "trunc" << "round" << "roundEven" << "ceil" << "fract" << "mod"
+				<< "modf" << "min" << "max" << "clamp" << "mix" << "step"
+				<< "smoothstep" << "isnan" << "isinf" << "floatBitsToInt" << "floatBitsToUint" << "intBitsToFloat"
+				<< "uintBitsToFloat" << "length" << "distance" << "dot" << "cross" << "normalize"
+				<< "ftransform" << "faceforward" << "reflect" << "refract" << "matrixCompMult" << "outerProduct"
+				<< "transpose" << "determinant" << "inverse" << "lessThan" << "lessThanEqual" << "greaterThan"
+				<< "greaterThanEqual" << "equal" << "notEqual" << "any" << "all" << "not"
+				<< "textureSize" << "texture" << "textureProj" << "textureLod" << "textureOffset" << "texelFetch"
+				<< "texelFetchOffset" << "textureProjOffset" << "textureLodOffset" << "textureProjLod" << "textureProjLodOffset" << "textureGrad"
+				<< "textureGradOffset" << "textureProjGrad" << "textureProjGradOffset" << "texture1D" << "texture1DLod" << "texture1DProj"
+				<< "texture1DProjLod" << "texture2D" << "texture2DLod" << "texture2DProj" << "texture2DProjLod" << "texture3D"
+				<< "texture3DLod" << "texture3DProj" << "texture3DProjLod" << "textureCube" << "textureCubeLod" << "shadow1D"
+				<< "shadow1DLod" << "shadow1DProj" << "shadow1DProjLod" << "shadow2D" << "shadow2DLod" << "shadow2DProj"
+				<< "shadow2DProjLod" << "dFdx" << "dFdy" << "fwidth" << "noise1" << "noise2"
+				<< "noise3" << "noise4";
+		// built-in functions
+
+		QVector<Rule> built;
+		built.append({QRegularExpression("\\b(?:" + keywords.join('|') + ")\\b"), keywordFormat});
+		built.append({QRegularExpression("\\b(?:" + functions.join('|') + ")\\b"), functionFormat});
+		for(Rule &rule : built) rule.regexp.optimize();
+		return built;
+	}();
+	return table;
 }
 
 void GLSLSyntax::highlightBlock(const QString &text)
 {
-	foreach (const Rule &rule, keywordRules)
+	for(const Rule &rule : rules())
 	{
 		QRegularExpressionMatchIterator matchIterator = rule.regexp.globalMatch(text);
 		// set regular expression to look for in text
@@ -113,14 +87,4 @@ void GLSLSyntax::highlightBlock(const QString &text)
 			// set formatting if regular expression is found
 		}
 	}
-
-	foreach (const Rule &rule, functionRules)
-	{
-		QRegularExpressionMatchIterator matchIterator = rule.regexp.globalMatch(text);
-		while (matchIterator.hasNext())
-		{
-			QRegularExpressionMatch match = matchIterator.next();
-			setFormat(match.capturedStart(), match.capturedLength(), rule.wordFormat);
-		}
-	}
 }
@@ -16,17 +16,13 @@ protected:
 	void highlightBlock(const QString&);
 
 private:
-	QTextCharFormat keywordFormat;
-	QTextCharFormat functionFormat;
-
 	struct Rule
 	{
 		QRegularExpression regexp;
 		QTextCharFormat wordFormat;
 	};
 
-	QVector<Rule> keywordRules;
-	QVector<Rule> functionRules;
+	static const QVector<Rule> &rules();	// shared by every editor
 };
 
 #endif // GLSLSYNTAX_H
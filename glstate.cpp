@@ -0,0 +1,378 @@
+#include "glstate.h"
+
+unsigned GLState::FrameStats::totalRequested() const
+{
+	unsigned total = 0;
+	for(auto calls : requested) total += calls;
+	return total;
+}
+
+unsigned GLState::FrameStats::totalIssued() const
+{
+	unsigned total = 0;
+	for(auto calls : issued) total += calls;
+	return total;
+}
+
+const char *GLState::callName(Call call)
+{
+	static const char *names[CallCount] =
+	{
+		"glUseProgram", "glBindVertexArray", "glBindBuffer", "glBindFramebuffer", "glActiveTexture",
+		"glBindTexture", "glEnable", "glDisable", "glEnableVertexAttribArray", "glViewport",
+		"glClearColor", "glClearDepth", "glClear", "glGetUniformLocation", "glUniform*",
+		"glBuffer*Data", "glTex*Image*", "glDraw*", "glDispatchCompute"
+	};
+	return names[call];
+}
+
+bool GLState::request(Call call, bool changes)
+{
+	++current.requested[call];
+	if(changes)
+	{
+		++current.issued[call];
+		if(call != Clear && call != Draw && call != Dispatch && call != UniformLocation && call != BufferData && call != TextureUpload)
+			++current.stateChanges;
+	}
+	return changes;
+}
+
+void GLState::log(const QString &text, bool issued)
+{
+	trace << "  " << text << (issued ? "\n" : "    [skipped]\n");
+}
+
+void GLState::beginFrame()
+{
+	++frame;
+	drawFramebuffer = readFramebuffer = unknown;
+	view[0] = view[1] = view[2] = view[3] = -1;
+	// the capture and the A/B comparison bind their own framebuffers behind the tracker's back,
+	// so a frame starts without assumptions and binds the window's framebuffer through the tracker
+
+	if(isTracing()) trace << "frame " << frame << "\n";
+}
+
+void GLState::endFrame()
+{
+	previous = current;
+	current = FrameStats();
+	if(isTracing()) trace.flush();
+}
+
+void GLState::invalidate()
+{
+	program = vertexArray = arrayBuffer = indirectBuffer = unknown;
+	drawFramebuffer = readFramebuffer = activeUnit = unknown;
+	textures.clear();
+	vertexArrays.clear();
+	capabilities.clear();
+	indexedBuffers.clear();
+	view[0] = view[1] = view[2] = view[3] = -1;
+	color[0] = color[1] = color[2] = color[3] = -1;
+	depth = -1;
+	uniforms.clear();
+}
+
+void GLState::forgetProgram(GLuint id)
+{
+	if(program == id) program = unknown;
+	for(auto i = locations.begin(); i != locations.end();)
+	{
+		if(i.key().first == id) i = locations.erase(i);
+		else ++i;
+	}
+	for(auto i = uniforms.begin(); i != uniforms.end();)
+	{
+		if(i->first.first == id) i = uniforms.erase(i);
+		else ++i;
+	}
+	// program names are reused by GL after deletion, so nothing about the old one may stick around
+}
+
+bool GLState::startTrace(const QString &path)
+{
+	stopTrace();
+	traceFile.setFileName(path);
+	if(!traceFile.open(QFile::WriteOnly | QFile::Text)) return false;
+	trace.setDevice(&traceFile);
+	return true;
+}
+
+void GLState::stopTrace()
+{
+	if(!isTracing()) return;
+	trace.flush();
+	trace.setDevice(nullptr);
+	traceFile.close();
+}
+
+void GLState::useProgram(GLuint id)
+{
+	bool issue = request(UseProgram, program != id);
+	if(isTracing()) log(QString("glUseProgram(%1)").arg(id), issue);
+	if(!issue) return;
+	glUseProgram(id);
+	program = id;
+}
+
+void GLState::bindVertexArray(GLuint id)
+{
+	bool issue = request(BindVertexArray, vertexArray != id);
+	if(isTracing()) log(QString("glBindVertexArray(%1)").arg(id), issue);
+	if(!issue) return;
+	glBindVertexArray(id);
+	vertexArray = id;
+}
+
+void GLState::bindBuffer(GLenum target, GLuint id)
+{
+	GLuint *bound = nullptr;
+	if(target == GL_ARRAY_BUFFER) bound = &arrayBuffer;
+	else if(target == GL_DRAW_INDIRECT_BUFFER) bound = &indirectBuffer;
+	else if(target == GL_ELEMENT_ARRAY_BUFFER && vertexArray != unknown)
+		bound = &vertexArrays[vertexArray].elementBuffer;	// the element buffer binding belongs to the VAO
+	// other targets aren't tracked and always go through
+
+	bool issue = request(BindBuffer, bound == nullptr || *bound != id);
+	if(isTracing()) log(QString("glBindBuffer(0x%1, %2)").arg(target, 0, 16).arg(id), issue);
+	if(!issue) return;
+	glBindBuffer(target, id);
+	if(bound) *bound = id;
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint id)
+{
+	auto key = qMakePair(target, index);
+	auto bound = indexedBuffers.find(key);
+	bool issue = request(BindBuffer, bound == indexedBuffers.end() || bound->second != id);
+	if(isTracing()) log(QString("glBindBufferBase(0x%1, %2, %3)").arg(target, 0, 16).arg(index).arg(id), issue);
+	if(!issue) return;
+	glBindBufferBase(target, index, id);
+	indexedBuffers[key] = id;
+	// binding to an indexed point also binds the generic target, which isn't tracked so needs no update
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size)
+{
+	request(BindBuffer, true);	// ranges move every frame, not worth comparing
+	if(isTracing())
+		log(QString("glBindBufferRange(0x%1, %2, %3, at %4, %5 bytes)").arg(target, 0, 16).arg(index).arg(id)
+			.arg(offset).arg(size), true);
+	glBindBufferRange(target, index, id, offset, size);
+	indexedBuffers[qMakePair(target, index)] = unknown;	// a later glBindBufferBase has to go through
+}
+
+void GLState::bindFramebuffer(GLenum target, GLuint id)
+{
+	bool issue;
+	if(target == GL_FRAMEBUFFER) issue = drawFramebuffer != id || readFramebuffer != id;
+	else if(target == GL_DRAW_FRAMEBUFFER) issue = drawFramebuffer != id;
+	else issue = readFramebuffer != id;
+
+	issue = request(BindFramebuffer, issue);
+	if(isTracing()) log(QString("glBindFramebuffer(0x%1, %2)").arg(target, 0, 16).arg(id), issue);
+	if(!issue) return;
+	glBindFramebuffer(target, id);
+	if(target != GL_READ_FRAMEBUFFER) drawFramebuffer = id;
+	if(target != GL_DRAW_FRAMEBUFFER) readFramebuffer = id;
+}
+
+void GLState::bindTexture(GLuint unit, GLenum target, GLuint id)
+{
+	auto key = qMakePair(unit, target);
+	auto bound = textures.find(key);
+	bool issue = request(BindTexture, bound == textures.end() || bound->second != id);
+	if(isTracing()) log(QString("glBindTexture(unit %1, 0x%2, %3)").arg(unit).arg(target, 0, 16).arg(id), issue);
+	if(!issue) return;
+
+	bool switchUnit = request(ActiveTexture, activeUnit != unit);
+	if(isTracing()) log(QString("glActiveTexture(GL_TEXTURE%1)").arg(unit), switchUnit);
+	if(switchUnit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+	// the active unit only matters when something is actually bound
+
+	glBindTexture(target, id);
+	textures[key] = id;
+}
+
+void GLState::enable(GLenum capability)
+{
+	auto known = capabilities.find(capability);
+	bool issue = request(Enable, known == capabilities.end() || !known->second);
+	if(isTracing()) log(QString("glEnable(0x%1)").arg(capability, 0, 16), issue);
+	if(!issue) return;
+	glEnable(capability);
+	capabilities[capability] = true;
+}
+
+void GLState::disable(GLenum capability)
+{
+	auto known = capabilities.find(capability);
+	bool issue = request(Disable, known == capabilities.end() || known->second);
+	if(isTracing()) log(QString("glDisable(0x%1)").arg(capability, 0, 16), issue);
+	if(!issue) return;
+	glDisable(capability);
+	capabilities[capability] = false;
+}
+
+void GLState::enableVertexAttribArray(GLuint index)
+{
+	bool issue = vertexArray == unknown || index >= 32
+			|| !(vertexArrays[vertexArray].enabledAttribs & (1u << index));
+	issue = request(EnableAttrib, issue);
+	if(isTracing()) log(QString("glEnableVertexAttribArray(%1)").arg(index), issue);
+	if(!issue) return;
+	glEnableVertexAttribArray(index);
+	if(vertexArray != unknown && index < 32) vertexArrays[vertexArray].enabledAttribs |= 1u << index;
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei w, GLsizei h)
+{
+	bool issue = request(Viewport, view[0] != x || view[1] != y || view[2] != w || view[3] != h);
+	if(isTracing()) log(QString("glViewport(%1, %2, %3, %4)").arg(x).arg(y).arg(w).arg(h), issue);
+	if(!issue) return;
+	glViewport(x, y, w, h);
+	view[0] = x; view[1] = y; view[2] = w; view[3] = h;
+}
+
+void GLState::clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+	bool issue = request(ClearColor, color[0] != r || color[1] != g || color[2] != b || color[3] != a);
+	if(isTracing()) log(QString("glClearColor(%1, %2, %3, %4)").arg(r).arg(g).arg(b).arg(a), issue);
+	if(!issue) return;
+	glClearColor(r, g, b, a);
+	color[0] = r; color[1] = g; color[2] = b; color[3] = a;
+}
+
+void GLState::clearDepth(GLdouble value)
+{
+	bool issue = request(ClearDepth, depth != value);
+	if(isTracing()) log(QString("glClearDepth(%1)").arg(value), issue);
+	if(!issue) return;
+	glClearDepth(value);
+	depth = value;
+}
+
+void GLState::clear(GLbitfield mask)
+{
+	request(Clear, true);
+	if(isTracing()) log(QString("glClear(0x%1)").arg(mask, 0, 16), true);
+	glClear(mask);
+}
+
+GLint GLState::uniformLocation(GLuint id, const char *name)
+{
+	auto key = qMakePair(id, QByteArray(name));
+	auto known = locations.find(key);
+	bool issue = request(UniformLocation, known == locations.end());
+	if(isTracing()) log(QString("glGetUniformLocation(%1, \"%2\")").arg(id).arg(name), issue);
+	if(!issue) return known.value();
+	GLint location = glGetUniformLocation(id, name);
+	locations.insert(key, location);
+	return location;
+}
+
+bool GLState::setUniform(GLint location, GLfloat x, GLfloat y)
+{
+	if(location < 0 || program == unknown) return location >= 0;	// nothing to remember it for
+	auto key = qMakePair(program, location);
+	auto value = qMakePair(x, y);
+	auto known = uniforms.find(key);
+	if(known != uniforms.end() && known->second == value) return false;
+	uniforms[key] = value;
+	return true;
+}
+
+void GLState::uniform1i(GLint location, GLint value)
+{
+	bool issue = request(Uniform, setUniform(location, GLfloat(value), 0));
+	if(isTracing()) log(QString("glUniform1i(%1, %2)").arg(location).arg(value), issue);
+	if(issue) glUniform1i(location, value);
+}
+
+void GLState::uniform1f(GLint location, GLfloat value)
+{
+	bool issue = request(Uniform, setUniform(location, value, 0));
+	if(isTracing()) log(QString("glUniform1f(%1, %2)").arg(location).arg(value), issue);
+	if(issue) glUniform1f(location, value);
+}
+
+void GLState::uniform2f(GLint location, GLfloat x, GLfloat y)
+{
+	bool issue = request(Uniform, setUniform(location, x, y));
+	if(isTracing()) log(QString("glUniform2f(%1, %2, %3)").arg(location).arg(x).arg(y), issue);
+	if(issue) glUniform2f(location, x, y);
+}
+
+void GLState::uniformMatrix4fv(GLint location, const GLfloat *value)
+{
+	bool issue = request(Uniform, location >= 0);	// 16 floats aren't worth remembering
+	if(isTracing()) log(QString("glUniformMatrix4fv(%1)").arg(location), issue);
+	if(issue) glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+void GLState::bufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+	request(BufferData, true);
+	if(data) current.bytesUploaded += size;	// without data it only allocates
+	if(isTracing()) log(QString("glBufferData(0x%1, %2 bytes)").arg(target, 0, 16).arg(size), true);
+	glBufferData(target, size, data, usage);
+}
+
+void GLState::bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+{
+	request(BufferData, true);
+	current.bytesUploaded += size;
+	if(isTracing())
+		log(QString("glBufferSubData(0x%1, at %2, %3 bytes)").arg(target, 0, 16).arg(offset).arg(size), true);
+	glBufferSubData(target, offset, size, data);
+}
+
+void GLState::textureUploaded(size_t bytes)
+{
+	if(bytes == 0) return;
+	request(TextureUpload, true);
+	current.bytesUploaded += bytes;
+	if(isTracing()) log(QString("texture upload (%1 bytes)").arg(bytes), true);
+}
+
+void GLState::drawElements(GLenum mode, GLsizei count, GLenum type, const void *offset)
+{
+	request(Draw, true);
+	if(isTracing()) log(QString("glDrawElements(0x%1, %2)").arg(mode, 0, 16).arg(count), true);
+	glDrawElements(mode, count, type, offset);
+}
+
+void GLState::drawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	request(Draw, true);
+	if(isTracing()) log(QString("glDrawArrays(0x%1, %2, %3)").arg(mode, 0, 16).arg(first).arg(count), true);
+	glDrawArrays(mode, first, count);
+}
+
+void GLState::drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *offset, GLint baseVertex)
+{
+	request(Draw, true);
+	if(isTracing())
+		log(QString("glDrawElementsBaseVertex(0x%1, %2, base %3)").arg(mode, 0, 16).arg(count).arg(baseVertex), true);
+	glDrawElementsBaseVertex(mode, count, type, const_cast<void*>(offset), baseVertex);
+}
+
+void GLState::multiDrawElementsIndirect(GLenum mode, GLenum type, const void *offset, GLsizei draws, GLsizei stride)
+{
+	request(Draw, true);
+	if(isTracing()) log(QString("glMultiDrawElementsIndirect(0x%1, %2 draws)").arg(mode, 0, 16).arg(draws), true);
+	glMultiDrawElementsIndirect(mode, type, offset, draws, stride);
+}
+
+void GLState::dispatchCompute(GLuint x, GLuint y, GLuint z)
+{
+	request(Dispatch, true);
+	if(isTracing()) log(QString("glDispatchCompute(%1, %2, %3)").arg(x).arg(y).arg(z), true);
+	glDispatchCompute(x, y, z);
+}
@@ -0,0 +1,114 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <map>
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QByteArray>
+#include <QTextStream>
+#include <GL/glew.h>
+
+/** CLARIFICATION:
+ * GLState sits between the GL widget and GL for everything that is done every frame. It remembers
+ * the state it has set and drops calls that wouldn't change anything (binding what's already bound,
+ * enabling what's already enabled...), counts every call per frame, and can write a trace of the calls
+ * to a file. Code that changes GL state behind its back (uploads, framebuffer juggling) has to call
+ * invalidate() afterwards, so the remembered state is never trusted when it might be wrong.
+ **/
+
+class GLState
+{
+public:
+	enum Call
+	{
+		UseProgram, BindVertexArray, BindBuffer, BindFramebuffer, ActiveTexture, BindTexture,
+		Enable, Disable, EnableAttrib, Viewport, ClearColor, ClearDepth, Clear,
+		UniformLocation, Uniform, BufferData, TextureUpload, Draw, Dispatch, CallCount
+	};
+
+	struct FrameStats
+	{
+		unsigned requested[CallCount] = {};	// calls made by the IDE
+		unsigned issued[CallCount] = {};	// calls that actually reached GL
+		unsigned stateChanges = 0;
+		size_t bytesUploaded = 0;
+
+		unsigned totalRequested() const;
+		unsigned totalIssued() const;
+	};
+
+	static const char *callName(Call);
+
+	void beginFrame();
+	void endFrame();
+	void invalidate();
+	void forgetProgram(GLuint);
+	const FrameStats &lastFrame() const { return previous; }
+	unsigned frameNumber() const { return frame; }
+
+	bool startTrace(const QString&);
+	void stopTrace();
+	bool isTracing() const { return traceFile.isOpen(); }
+
+	void useProgram(GLuint);
+	void bindVertexArray(GLuint);
+	void bindBuffer(GLenum, GLuint);
+	void bindBufferBase(GLenum, GLuint index, GLuint);
+	void bindBufferRange(GLenum, GLuint index, GLuint, GLintptr, GLsizeiptr);
+	void bindFramebuffer(GLenum, GLuint);
+	void bindTexture(GLuint unit, GLenum target, GLuint);
+	void enable(GLenum);
+	void disable(GLenum);
+	void enableVertexAttribArray(GLuint);
+	void viewport(GLint, GLint, GLsizei, GLsizei);
+	void clearColor(GLfloat, GLfloat, GLfloat, GLfloat);
+	void clearDepth(GLdouble);
+	void clear(GLbitfield);
+	GLint uniformLocation(GLuint, const char*);
+	void uniform1i(GLint, GLint);
+	void uniform1f(GLint, GLfloat);
+	void uniform2f(GLint, GLfloat, GLfloat);
+	void uniformMatrix4fv(GLint, const GLfloat*);
+	void bufferData(GLenum, GLsizeiptr, const void*, GLenum);
+	void bufferSubData(GLenum, GLintptr, GLsizeiptr, const void*);
+	void textureUploaded(size_t);
+	void drawElements(GLenum, GLsizei, GLenum, const void*);
+	void drawArrays(GLenum, GLint, GLsizei);
+	void drawElementsBaseVertex(GLenum, GLsizei, GLenum, const void*, GLint);
+	void multiDrawElementsIndirect(GLenum, GLenum, const void*, GLsizei, GLsizei);
+	void dispatchCompute(GLuint, GLuint, GLuint);
+
+private:
+	static const GLuint unknown = 0xFFFFFFFFu;	// state we don't know and must set unconditionally
+
+	struct VertexArrayState
+	{
+		GLuint elementBuffer = unknown;
+		unsigned enabledAttribs = 0;	// bit per attribute index, attribute arrays are VAO state
+	};
+
+	GLuint program = unknown, vertexArray = unknown, arrayBuffer = unknown, indirectBuffer = unknown;
+	GLuint drawFramebuffer = unknown, readFramebuffer = unknown, activeUnit = unknown;
+	std::map<QPair<GLuint, GLenum>, GLuint> textures;	// unit and target to texture
+	std::map<GLuint, VertexArrayState> vertexArrays;
+	std::map<GLenum, bool> capabilities;
+	std::map<QPair<GLenum, GLuint>, GLuint> indexedBuffers;	// target and binding point to buffer
+	GLint view[4] = {-1, -1, -1, -1};
+	GLfloat color[4] = {-1, -1, -1, -1};
+	GLdouble depth = -1;
+	QHash<QPair<GLuint, QByteArray>, GLint> locations;	// survives invalidate(), only relinking changes them
+	std::map<QPair<GLuint, GLint>, QPair<GLfloat, GLfloat>> uniforms;	// last value per program and location
+
+	FrameStats current, previous;
+	unsigned frame = 0;
+	QFile traceFile;
+	QTextStream trace;
+
+	bool request(Call, bool changes);
+	void log(const QString&, bool issued);
+	bool setUniform(GLint, GLfloat, GLfloat);
+};
+
+#endif // GLSTATE_H
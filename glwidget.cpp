@@ -1,449 +1,589 @@
 #include "glwidget.h"
 
-GLWidget::GLWidget(QWidget *parent) : QOpenGLWidget(parent), time(0.0f)
+GLWidget::GLWidget(QWidget *parent) : QWidget(parent), time(0.0f), scene(resources), textures(resources), builtIns(resources),
+	compute(resources), heatmap(resources)
 {
 	setWindowTitle("GL Context");
+	resize(640, 480);
+
+	window = new QWindow();
+	window->setSurfaceType(QSurface::OpenGLSurface);
+	window->setFormat(QSurfaceFormat::defaultFormat());
+	window->installEventFilter(this);
+	QVBoxLayout *layout = new QVBoxLayout(this);
+	layout->setContentsMargins(0, 0, 0, 0);
+	layout->addWidget(QWidget::createWindowContainer(window, this));
+	// the render thread draws straight into this window, the container only places it
+
+	renderer = new RenderThread(window, this);
+	renderer->initialize = [this]() { initializeGL(); };
+	renderer->render = [this]() { paintGL(); };
+	renderer->cleanup = [this]() { releaseGL(); };
+
+	capture = new FrameCapture(resources, this);
+	connect(capture, SIGNAL(progress(int,int)), this, SIGNAL(captureProgress(int,int)));
+	connect(capture, SIGNAL(finished(QString)), this, SIGNAL(captureFinished(QString)));
+	// forward capture state to whoever started it
 }
 
 void GLWidget::initializeGL()
 {
-	makeCurrent();	// make this widget the GL context
 	glewExperimental = GL_TRUE;
 	glewInit();	// enable glew functions
+	state.invalidate();	// nothing is known about a fresh context
 
-	verts.push_back(vec3(-1.0f, -1.0f, 0.0f));
-	verts.push_back(vec3(1.0f, -1.0f, 0.0f));
-	verts.push_back(vec3(-1.0f, 1.0f, 0.0f));
-	verts.push_back(vec3(1.0f, 1.0f, 0.0f));
-	uvs.push_back(vec2(0.0f, 0.0f));
-	uvs.push_back(vec2(1.0f, 0.0f));
-	uvs.push_back(vec2(0.0f, 1.0f));
-	uvs.push_back(vec2(1.0f, 1.0f));
-	// declare square coordinates for default shader
-
-	elems[0].push_back(0);
-	elems[0].push_back(1);
-	elems[0].push_back(2);
-	elems[0].push_back(2);
-	elems[0].push_back(1);
-	elems[0].push_back(3);
-
-	elems[1].push_back(0);
-	elems[1].push_back(1);
-	elems[1].push_back(2);
-	elems[1].push_back(2);
-	elems[1].push_back(1);
-	elems[1].push_back(3);
-
-	glGenVertexArrays(1, &vertexArray);	// create vertex array for the data that will be declared next
-	glBindVertexArray(vertexArray);	// and bind it
-
-	glGenBuffers(3, vertexBuffers);
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*verts.size(), verts.data(), GL_STATIC_DRAW);
-    // write square to buffer
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	// create vertex array pointer to the square buffer
-
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[1]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vec2)*uvs.size(), uvs.data(), GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[2]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*normals.size(), normals.data(), GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-	glGenBuffers(3, elementBuffers);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffers[0]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned)*elems[0].size(), elems[0].data(), GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffers[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned)*elems[1].size(), elems[1].data(), GL_STATIC_DRAW);
-
-	glGenTextures(1, &texture);
-	// create a texture to be used in the context if needed
-
-	glEnable(GL_BLEND);
+	scene.create(state);	// shared vertex and index buffers for every mesh that will be imported
+	addQuad();
+	builtIns.create(state);	// the uniform block behind time, resolution, mouse...
+
+	state.enable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_DEPTH_CLAMP);
+	state.enable(GL_DEPTH_TEST);
+	state.enable(GL_DEPTH_CLAMP);
 	glDepthRange(0.0001f, 100.0f);
 	glDepthFunc(GL_LESS);
 
-	glClearColor(0,0,0,1);
+	state.clearColor(0,0,0,1);
+	StartupTrace::mark("GL context initialized");
+	// imports made before the preview was first shown have been queued, and run next
 }
 
-void GLWidget::loadTexture(QString path)
+void GLWidget::withContext(std::function<void()> work)
 {
-	if(path == "") return;	// if there is no file loaded, don't do anything
-	QImage image = QImage(path);	// load image from path
-	image = image.convertToFormat(QImage::Format_RGBA8888, Qt::AutoColor);	// convert image to RGBA
-	image = image.mirrored();	// flip it
-
-	show();	// make context visible to be able to load the texture
-	glBindTexture(GL_TEXTURE_2D, texture);	// bind the GL texture
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(),
-				 0, GL_RGBA, GL_UNSIGNED_BYTE, image.bits());	// write image to GL texture
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	// set texture filtering - the texture doesn't render without these 2 lines
-
-	glBindTexture(GL_TEXTURE_2D, 0);	// unbind the GL texture
-	close();	// close the context as it is no longer needed
+	renderer->post([this, work]()
+	{
+		work();
+		publishReport();	// e.g. the memory a new texture takes, without waiting for a frame
+	});
+	// runs on the render thread before its next frame, whether the preview is shown or not
 }
 
-void GLWidget::loadModel(QString path)
+void GLWidget::showEvent(QShowEvent*)
 {
-	/** CLARIFICATION:
-	 * An .obj file contains different vertices, indices and faces on every line in the following way:
-	 * - If a line begins with "v", then that is a modelspace vertex coordinate
-	 * - If a line begins with "vt", then that is a UV coordinate for texture mapping
-	 * - If a line begins with "vn", then that is a vertex normal coordinate for lighting (unused here)
-	 * - If a line begins with "f", then that is a face, which is made up of multiple vertices.
-	 *	Such a line can have 4 different formats:
-	 *	- When there are no "vt" or "vn" lines, the face will only have "v" coordinates
-	 *	- When there are "vt" lines, the face can have either "v/vt" or "v/vt/vn" coordinates
-	 *	- When there are "vn" lines, the face can have either "v/vt/vn" or "v//vn" coordinates
-	**/
+	renderer->begin();	// no context, and no thread, until the preview is first shown
+}
 
-	if(path == "") return;	// if there is no file loaded, don't do anything
-	std::ifstream file(path.toStdString());	// open file located at "path"
-
-	verts.clear();
-	verts.shrink_to_fit();
-	uvs.clear();
-	uvs.shrink_to_fit();
-	normals.clear();
-	normals.shrink_to_fit();
-	elems[0].clear();
-	elems[0].shrink_to_fit();
-	elems[1].clear();
-	elems[1].shrink_to_fit();
-	elems[2].clear();
-	elems[2].shrink_to_fit();
-
-	std::string line;	// declare a string that will hold the contents of every line in the file
-	while(std::getline(file, line))
+bool GLWidget::eventFilter(QObject *object, QEvent *event)
+{
+	if(object != window) return false;
+	QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
+	qreal scale = window->devicePixelRatio();
+	switch(event->type())
 	{
-		std::stringstream lineStream(line);	// make a stream from the string to tokenize it
-		std::string token;
-		std::getline(lineStream, token, ' ');	// tokenize to see what the first argument of a line is
-		if(token == "v")	// look for vertex coordinates first
-		{
-			vec3 tempVertex;
-			lineStream >> tempVertex.x >> tempVertex.y >> tempVertex.z;
-			verts.push_back(tempVertex);	// put the coordinates in the buffer
-		}
-		else if(token == "vt")	// look for UV coordinates
-		{
-			hasUVs = true;
-			vec2 tempVertex;
-			lineStream >> tempVertex.x >> tempVertex.y;
-			uvs.push_back(tempVertex);
-		}
-		else if(token == "vn")
-		{
-			hasNormals = true;
-			vec3 tempVertex;
-			lineStream >> tempVertex.x >> tempVertex.y >> tempVertex.z;
-			normals.push_back(tempVertex);
-		}
-		else if(token == "f")
-		{
-			/** CLARIFICATION:
-				 * Because of the way this program works, in order to make a polygon face draw properly,
-				 * the following improvisations were used:
-				 * - The face is considered to be convex and as if it was drawn using GL_TRIANGLE_FAN
-				 * - As such, the face was "parsed" into adjacent triangles that all share the first
-				 * coordinate.
-				 * I have no idea what the impact of such an overhead poses, but I suspect it to be
-				 * within the bounds of O(n) in both memory and speed efficiency.
-				 **/
-
-			/** CODE IN TESTING BELOW **/
-
-			unsigned v1, vt1, vn1;
-			std::string str = lineStream.str();
-			str = str.substr(str.find(' ')+1, str.size());
-			if(sscanf(str.c_str(), "%d/%d/%d", &v1, &vt1, &vn1) == 3)	// if format of "f" is "v/vt/vn"
-			{
-				while(str.find(' ')!=0)
-				{
-				unsigned v2, vt2, vn2, v3, vt3, vn3;
-				str = str.substr(str.find(' ')+1, str.size());
-				if(sscanf(str.c_str(), "%d/%d/%d %d/%d/%d", &v2, &vt2, &vn2, &v3, &vt3, &vn3) != 6) break;
-				elems[0].push_back(v1-1);
-				elems[0].push_back(v2-1);
-				elems[0].push_back(v3-1);
-				// push indices to element array containing modelspace vertices
-				elems[1].push_back(vt1-1);
-				elems[1].push_back(vt2-1);
-				elems[1].push_back(vt3-1);
-				// push indices to element array containing UVs
-				elems[2].push_back(vn1-1);
-				elems[2].push_back(vn2-1);
-				elems[2].push_back(vn3-1);
-				// push indices to element array containing normals
-				}
-			}
-			else if(sscanf(str.c_str(), "%d//%d", &v1, &vn1) == 2)	// if format of "f" is "v//vn"
-			{
-				while(str.find(' ')!=0)
-				{
-				unsigned v2, vn2, v3, vn3;
-				str = str.substr(str.find(' ')+1, str.size());
-				if(sscanf(str.c_str(), "%d//%d %d//%d", &v2, &vn2, &v3, &vn3) != 4) break;
-				elems[0].push_back(v1-1);
-				elems[0].push_back(v2-1);
-				elems[0].push_back(v3-1);
-				// push indices to element array containing modelspace vertices
-				elems[1].push_back(0);
-				elems[1].push_back(0);
-				elems[1].push_back(0);
-				// push indices to element array containing UVs
-				elems[2].push_back(vn1-1);
-				elems[2].push_back(vn2-1);
-				elems[2].push_back(vn3-1);
-				// push indices to element array containing normals
-				}
-			}
-			else if(sscanf(str.c_str(), "%d/%d", &v1, &vt1) == 2)	// if format of "f" is "v/vt"
-			{
-				while(str.find(' ')!=0)
-				{
-				unsigned v2, vt2, v3, vt3;
-				str = str.substr(str.find(' ')+1, str.size());
-				if(sscanf(str.c_str(), "%d/%d %d/%d", &v2, &vt2, &v3, &vt3) != 4) break;
-				elems[0].push_back(v1-1);
-				elems[0].push_back(v2-1);
-				elems[0].push_back(v3-1);
-				// push indices to element array containing modelspace vertices
-				elems[1].push_back(vt1-1);
-				elems[1].push_back(vt2-1);
-				elems[1].push_back(vt3-1);
-				// push indices to element array containing UVs
-				elems[2].push_back(0);
-				elems[2].push_back(0);
-				elems[2].push_back(0);
-				// push indices to element array containing normals
-				}
-			}
-			else	// if format of "f" is "v"
-			{
-				while(str.find(' ')!=0)
-				{
-				unsigned v2, v3;
-				str = str.substr(str.find(' ')+1, str.size());
-				if(sscanf(str.c_str(), "%d %d", &v2, &v3) != 2) break;
-				elems[0].push_back(v1-1);
-				elems[0].push_back(v2-1);
-				elems[0].push_back(v3-1);
-				// push indices to element array containing modelspace vertices
-				elems[1].push_back(0);
-				elems[1].push_back(0);
-				elems[1].push_back(0);
-				// push indices to element array containing UVs
-				elems[2].push_back(0);
-				elems[2].push_back(0);
-				elems[2].push_back(0);
-				// push indices to element array containing normals
-				}
-			}
-		}
+	case QEvent::Expose:
+		renderer->setExposed(window->isExposed());
+		return false;
+	case QEvent::Resize:
+		input.width = qMax(1, qRound(window->width() * scale));
+		input.height = qMax(1, qRound(window->height() * scale));
+		break;
+	case QEvent::MouseButtonPress:
+		input.mouse[0] = input.mouse[2] = mouseEvent->x() * scale;
+		input.mouse[1] = input.mouse[3] = input.height - mouseEvent->y() * scale;	// GL counts pixels from the bottom
+		break;
+	case QEvent::MouseMove:
+		if(!(mouseEvent->buttons() & Qt::LeftButton)) return false;
+		input.mouse[0] = mouseEvent->x() * scale;
+		input.mouse[1] = input.height - mouseEvent->y() * scale;
+		break;
+	case QEvent::MouseButtonRelease:
+		input.mouse[2] = -std::abs(input.mouse[2]);
+		input.mouse[3] = -std::abs(input.mouse[3]);
+		// the click position stays available, the sign tells that the button is up
+		break;
+	default:
+		return false;
 	}
-	for(auto i : elems[0]) std::cout << i << ' ';
-	std::cout << '\n';
-	for(auto i : elems[1]) std::cout << i << ' ';
+	inputs.publish(input);
+	return false;
+}
 
-	normalize();
+void GLWidget::publishReport()
+{
+	FrameReport report;
+	report.stats = state.lastFrame();
+	report.frame = state.frameNumber();
+	for(int kind = 0; kind < GLResources::KindCount; ++kind)
+	{
+		report.liveCount[kind] = resources.liveCount(GLResources::Kind(kind));
+		report.liveBytes[kind] = resources.liveBytes(GLResources::Kind(kind));
+	}
+	report.totalBytes = resources.liveBytes();
+	report.computeMilliseconds = compute.isActive() ? compute.milliseconds() : -1;
+	report.tracing = state.isTracing();
+	report.capturing = captureRequested || capture->isActive();
+	reports.publish(report);
+}
 
-	show();
+void GLWidget::loadTexture(QString slot, QStringList paths, int kind)
+{
+	if(paths.isEmpty()) return;	// if there is no file loaded, don't do anything
 
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*verts.size(), verts.data(), GL_STATIC_DRAW);
+	withContext([this, slot, paths, kind]()
+	{
+		QString error;
+		if(!textures.load(slot, paths, TextureManager::Kind(kind), error) && error != "")
+			emit shaderError("Could not import texture:\n" + error);
+		state.textureUploaded(textures.takeUploadedBytes());
+		state.invalidate();	// uploading and evicting bypass the state tracker
+		if(runningSpirv && !textures.slotNames().isEmpty()) replaceProgram(lastVertex, lastFragment);
+		// a SPIR-V program can't find the new sampler, the GLSL build of the same code can
+	});
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[1]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vec2)*uvs.size(), uvs.data(), GL_STATIC_DRAW);
+void GLWidget::reloadTexture(QString path)
+{
+	withContext([this, path]()
+	{
+		QString error;
+		if(!textures.reload(path, error) && error != "")
+			emit shaderError("Could not reload texture:\n" + error);	// the old texture stays bound
+		state.textureUploaded(textures.takeUploadedBytes());
+		state.invalidate();
+	});
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffers[2]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*normals.size(), normals.data(), GL_STATIC_DRAW);
+void GLWidget::setTextureBudget(int megabytes)
+{
+	withContext([this, megabytes]()
+	{
+		textures.setBudget(size_t(megabytes) << 20);
+		state.invalidate();
+	});
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffers[0]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int)*elems[0].size(), elems[0].data(), GL_STATIC_DRAW);
+void GLWidget::addQuad()
+{
+	quad = scene.add(state, MeshScene::square());	// declare square coordinates for default shader
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffers[1]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int)*elems[1].size(), elems[1].data(), GL_STATIC_DRAW);
+void GLWidget::loadModel(QString path)
+{
+	if(path == "") return;	// if there is no file loaded, don't do anything
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffers[2]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int)*elems[2].size(), elems[2].data(), GL_STATIC_DRAW);
+	ObjModel model;
+	if(!model.load(path.toStdString()))
+	{
+		emit shaderError("Could not import model:\n" + path);
+		return;
+	}
+	model.normalize();
+	bool reloaded = importedModels.contains(path);
+	importedModels.insert(path);
 
-	close();
+	withContext([this, path, model]()
+	{
+		if(quad >= 0)	// models are added to each other, only the default square goes away
+		{
+			scene.remove(quad);
+			quad = -1;
+		}
+		for(int mesh : models[path]) scene.remove(mesh);	// an earlier version of the same file
+		models[path].clear();
+		for(const MeshPart &part : model.parts) models[path].push_back(scene.add(state, part));
+		// every object of the file becomes its own mesh in the shared buffers
+	});
+	if(reloaded) return;	// it has been pointed out before
 
 	QMessageBox notify;
-	if(!hasUVs && !hasNormals)
+	if(!model.hasUVs && !model.hasNormals)
 		notify.setText("Selected model has no UV coordinates and no vertex normals. Textures and lighting will not be supported!");
-	else if(!hasUVs)
+	else if(!model.hasUVs)
 		notify.setText("Selected model has no UV coordinates. Textures will not be supported!");
-	else if(!hasNormals)
+	else if(!model.hasNormals)
 		notify.setText("Selected model has no vertex normals. Lighting will not be supported!");
 	if(notify.text().size() > 0) notify.exec();
 }
 
+void GLWidget::clearModels()
+{
+	importedModels.clear();
+	withContext([this]()
+	{
+		scene.clear();
+		models.clear();
+		addQuad();	// back to the default square
+	});
+}
+
 void GLWidget::paintGL()
 {
-	glViewport(0, 0, width(), height());	// GL context always has the size of the window
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);	// clear the color buffer
-	glClearDepth(1);
+	view = inputs.latest();	// size and mouse as the GUI thread last saw them
+	state.beginFrame();
+	state.bindFramebuffer(GL_FRAMEBUFFER, renderer->framebuffer());	// the window's, whatever was left bound
+	builtIns.nextFrame();
+	time += 0.01f;	// increase time (to do: base on real time)
+	deltaTime = frameTimer.isValid() ? frameTimer.restart() / 1000.0f : 0.0f;
+	if(!frameTimer.isValid()) frameTimer.start();
 
-	glUseProgram(current_shader);	// use the current shader code
+	if(comparisonRequested)
+	{
+		comparison.settings.time = time;	// freeze the current time for the whole comparison
+		runComparison();
+	}
 
-	time += 0.01f;	// increase time (to do: base on real time)
+	if(compute.isActive())
+	{
+		builtIns.update(state, builtInValues(time, view.width, view.height));
+		compute.dispatch(state);
+	}
+	// the compute stage runs first, the render pass can read its buffers and images right away
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	// bind texture to unit 0
+	if(heatmapMode != CostHeatmap::Off && costProgram)	// normal output on the left, counts on the right
+	{
+		int half = view.width / 2;
+		drawScene(current_shader, time, half, view.height);
+		heatmap.begin(state, half, view.height);
+		drawScene(costProgram, time, half, view.height);
+		heatmap.end(state, renderer->framebuffer(), half, 0, half, view.height, heatmapScale);
+	}
+	else drawScene(current_shader, time, view.width, view.height);	// GL context always has the size of the window
+
+	if(captureRequested)
+	{
+		captureRequested = false;
+		capture->start(requestedCapture);
+	}
+	capture->process([this](GLfloat t, int w, int h) { drawScene(current_shader, t, w, h); },
+					 renderer->framebuffer());
+	// renders and reads back pending capture frames into their own framebuffer
+
+	state.endFrame();
+	publishReport();
+}
+
+void GLWidget::drawScene(GLuint program, GLfloat t, int w, int h)
+{
+	state.viewport(0, 0, w, h);
+	state.clearDepth(1);
+	state.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);	// clear the color buffer
 
-    glUniform1f(glGetUniformLocation(current_shader, "time"), time);
-    glUniform2f(glGetUniformLocation(current_shader, "resolution"), this->width(), this->height());
-	glUniform1i(glGetUniformLocation(current_shader, "tex"), 0);
-	// update shader uniforms
+	state.useProgram(program);	// use the current shader code
 
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffers[0]);
-	glDrawElements(GL_TRIANGLES, elems[0].size(), GL_UNSIGNED_INT, 0);
+	textures.bind(state, program);
+	compute.bind(state, program, textures.slotNames().size());
+	// bind every imported texture to its own unit and point its sampler uniform there, then the compute images
 
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffers[1]);
-	glDrawElements(GL_TRIANGLES, elems[1].size(), GL_UNSIGNED_INT, 0);
+	builtIns.update(state, builtInValues(t, w, h));
+	// one copy updates the built-in uniforms of every program
 
-	glEnableVertexAttribArray(2);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffers[2]);
-	glDrawElements(GL_TRIANGLES, elems[2].size(), GL_UNSIGNED_INT, 0);
+	scene.draw(state, program);	// every mesh at once where GL supports it
+	compute.drawPoints(state);
 }
 
-void GLWidget::compileShader(std::string v, std::string f)
+BuiltIns GLWidget::builtInValues(GLfloat t, int w, int h) const
 {
-	std::string vv = "#version 330 core\n" + v;
-	std::string ff = "#version 330 core\n" + f;
-    // concatenate shader "heads" with code from the IDE
+	QDateTime now = QDateTime::currentDateTime();
+	BuiltIns values;
+	values.date[0] = now.date().year();
+	values.date[1] = now.date().month();
+	values.date[2] = now.date().day();
+	values.date[3] = now.time().msecsSinceStartOfDay() / 1000.0f;
+	std::copy(view.mouse, view.mouse + 4, values.mouse);
+	values.resolution[0] = w;
+	values.resolution[1] = h;
+	values.time = t;
+	values.deltaTime = deltaTime;
+	values.frame = int(state.frameNumber());
+	return values;
+}
 
-    GLuint v_shader = glCreateShader(GL_VERTEX_SHADER);
-    GLuint f_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    // declare empty shaders
+void GLWidget::compileShader(std::string v, std::string f)
+{
+	withContext([this, v, f]() { replaceProgram(v, f); });
+	// compiling happens on the render thread, the editor stays responsive meanwhile
+}
 
-    const char *v_char = vv.c_str();
-    const char *f_char = ff.c_str();
-    // convert to C strings for GL functions
+void GLWidget::replaceProgram(std::string v, std::string f)
+{
+	QString log;
+	bool spirv = false;
+	GLProgram shader_program = spirvPreset >= 0 ? buildSpirvProgram(v, f, log, spirv) : buildProgram(v, f, log);
+	if(!shader_program)	// if the shaders didn't compile or link, output error
+	{
+		emit shaderError(log);	// send text to textbox - the previous shader keeps running
+		return;
+	}
 
-    glShaderSource(v_shader, 1, &v_char, NULL);
-    glShaderSource(f_shader, 1, &f_char, NULL);
-    // send code to GL shaders
+	state.forgetProgram(current_shader);
+	current_shader = std::move(shader_program);
+	// push shader to context - the previous program is deleted here
+	runningSpirv = spirv;
+	lastVertex = v;
+	lastFragment = f;
+	if(heatmapMode != CostHeatmap::Off) buildHeatmap();	// the instrumented copy follows the editor
+}
 
-    /** compile vertex shader **/
+void GLWidget::buildHeatmap()
+{
+	state.forgetProgram(costProgram);
+	costProgram.reset();
+	if(heatmapMode == CostHeatmap::Off)
+	{
+		heatmap.release(state);
+		return;
+	}
+	if(lastFragment.empty()) return;	// built with the first shader that compiles
 
-    glCompileShader(v_shader);
+	QString log;
+	std::string fragment = heatmapMode == CostHeatmap::Cost ? CostHeatmap::instrument(lastFragment)
+															: CostHeatmap::overdrawShader();
+	costProgram = buildProgram(lastVertex, fragment, log);
+	if(!costProgram) emit shaderError("The heatmap shader didn't compile:\n" + log);
+}
 
-    GLint v_shader_status;
-    glGetShaderiv(v_shader, GL_COMPILE_STATUS, &v_shader_status);
-    // see if shader compiled properly
+void GLWidget::setHeatmap(int mode, float scale)
+{
+	withContext([this, mode, scale]()
+	{
+		heatmapMode = mode;
+		heatmapScale = scale;
+		buildHeatmap();
+	});
+}
 
-    if(v_shader_status == GL_FALSE) // if shader didn't compile, output error
-    {
-		close();
-        GLint v_maxLength;
-        glGetShaderiv(v_shader, GL_INFO_LOG_LENGTH, &v_maxLength);
-        // get length of error text
+std::string GLWidget::assemble(GLenum stage, const std::string &code, bool multiDraw, bool spirv)
+{
+	return (spirv ? "#version 450 core\n" : MeshScene::glslVersion(multiDraw))
+			+ std::string(BuiltInUniforms::declaration(spirv))
+			+ MeshScene::declarations(stage, multiDraw) + "#line 1\n" + BuiltInUniforms::strip(code);
+    // concatenate shader "heads" with code from the IDE, they declare the built-ins and modelMatrix
+	// "#line 1" keeps the line numbers in compiler errors the same as in the editor
+}
 
-        std::vector<GLchar> t_str(v_maxLength);
-        glGetShaderInfoLog(v_shader, v_maxLength, &v_maxLength, &t_str[0]);
-        // get error text
+GLProgram GLWidget::linkProgram(std::initializer_list<GLuint> shaders, bool retrievable, QString &log)
+{
+	GLProgram shader_program(resources, "shader program");
 
-        std::string v_str = "In vertex shader:\n";
-        v_str += t_str.data();
-        emit shaderError(QString::fromStdString(v_str));
-        // send text to textbox
-    }
+	if(retrievable) glProgramParameteri(shader_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	ShaderBuild::link(shader_program, shaders);	// move the shaders to program
 
-    /** repeat above but for the fragment shader **/
+	if(!ShaderBuild::linked(shader_program, log)) shader_program.reset();
+	else BuiltInUniforms::bindBlock(shader_program);
 
-    glCompileShader(f_shader);
+	return shader_program;
+}
 
-    GLint f_shader_status;
-    glGetShaderiv(f_shader, GL_COMPILE_STATUS, &f_shader_status);
+GLProgram GLWidget::buildProgram(const std::string &v, const std::string &f, QString &log)
+{
+	std::string vv = assemble(GL_VERTEX_SHADER, v, scene.usesMultiDraw(), false);
+	std::string ff = assemble(GL_FRAGMENT_SHADER, f, scene.usesMultiDraw(), false);
 
-    if(f_shader_status == GL_FALSE)
+	bool binaries = GLEW_ARB_get_program_binary;
+	QByteArray key = QCryptographicHash::hash(QByteArray::fromStdString(vv + '\0' + ff), QCryptographicHash::Sha1);
+	auto cached = programBinaries.constFind(key);
+	if(binaries && cached != programBinaries.constEnd())	// linked before, skip compiling and linking
 	{
-		close();
-        GLint f_maxLength;
-        glGetShaderiv(f_shader, GL_INFO_LOG_LENGTH, &f_maxLength);
-
-        std::vector<GLchar> t_str(f_maxLength);
-        glGetShaderInfoLog(f_shader, f_maxLength, &f_maxLength, &t_str[0]);
+		GLProgram program(resources, "shader program");
+		glProgramBinary(program, cached->first, cached->second.constData(), cached->second.size());
+		GLint status;
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		if(status == GL_TRUE)
+		{
+			BuiltInUniforms::bindBlock(program);
+			return program;
+		}
+		programBinaries.remove(key);	// the driver may reject binaries, e.g. after an update
+	}
 
-        std::string f_str = "In fragment shader:\n";
-        f_str += t_str.data();
-        emit shaderError(QString::fromStdString(f_str));
-    }
+	GLShader v_shader(resources, "vertex shader", GL_VERTEX_SHADER);
+	GLShader f_shader(resources, "fragment shader", GL_FRAGMENT_SHADER);
+    // declare empty shaders - they are deleted when leaving this function, whatever happens
 
-    GLuint shader_program = glCreateProgram();
+	ShaderBuild::compile(v_shader, vv);
+	ShaderBuild::compile(f_shader, ff);
+	bool compiled = ShaderBuild::compiled(v_shader, "vertex", log);
+	compiled = ShaderBuild::compiled(f_shader, "fragment", log) && compiled;
+	// compile both, so errors in both stages are reported at once
 
-    glAttachShader(shader_program, v_shader);
-    glAttachShader(shader_program, f_shader);
-    glLinkProgram(shader_program);
-    // move vertex and fragment shaders to program
+	GLProgram shader_program;
+	if(compiled) shader_program = linkProgram({v_shader, f_shader}, binaries, log);
 
-    glDetachShader(shader_program, v_shader);
-    glDetachShader(shader_program, f_shader);
-    glDeleteShader(v_shader);
-    glDeleteShader(f_shader);
-    // old shaders are unneeded now so delete them
+	if(shader_program && binaries)
+	{
+		GLint length = 0;
+		glGetProgramiv(shader_program, GL_PROGRAM_BINARY_LENGTH, &length);
+		QByteArray binary(length, 0);
+		GLenum format;
+		glGetProgramBinary(shader_program, length, nullptr, &format, binary.data());
+		if(programBinaries.size() >= 64) programBinaries.clear();	// a simple cap, edits rarely go back further
+		programBinaries.insert(key, qMakePair(format, binary));
+	}
 
-    current_shader = shader_program;
-	// push shader to context
+	return shader_program;
 }
 
-void GLWidget::reset() { time = 0; }
-
-void GLWidget::normalize()
+GLProgram GLWidget::buildSpirvProgram(const std::string &v, const std::string &f, QString &log, bool &fromSpirv)
 {
-	float max = 0.0f;
-	for(auto i : verts)
+	SpirvProgram spirv;
+	if(!SpirvCompiler::compile(assemble(GL_VERTEX_SHADER, v, scene.usesMultiDraw(), true),
+							   assemble(GL_FRAGMENT_SHADER, f, scene.usesMultiDraw(), true), spirv, log))
+		return GLProgram();
+
+	SpirvCompiler::Preset preset = SpirvCompiler::Preset(spirvPreset);
+	QString report = SpirvCompiler::report(spirv, preset);
+	if(!GLEW_ARB_gl_spirv)	// the counts are still worth seeing, but the driver has to compile the GLSL
 	{
-		if(i.x > max) max = i.x;
-		if(i.y > max) max = i.y;
-		if(i.z > max) max = i.z;
+		emit spirvReport(report + "The driver doesn't support GL_ARB_gl_spirv, the GLSL source is running.\n");
+		return buildProgram(v, f, log);
 	}
-	if(max > 1.0f)
-		for(auto &&i : verts)
-		{
-			i.x /= max;
-			i.y /= max;
-			i.z /= max;
-		}
-	for(auto i : normals)
+	if(!textures.slotNames().isEmpty() || compute.hasImages())
 	{
-		if(i.x > max) max = i.x;
-		if(i.y > max) max = i.y;
-		if(i.z > max) max = i.z;
+		emit spirvReport(report + "Texture slots and compute images are bound by sampler name, which SPIR-V programs "
+								  "don't keep, so the GLSL source is running.\n");
+		return buildProgram(v, f, log);
 	}
-	if(max > 1.0f)
-		for(auto &&i : normals)
+
+	std::vector<uint32_t> vertex, fragment;
+	if(!SpirvCompiler::optimize(spirv.vertex, preset, vertex, log)
+			|| !SpirvCompiler::optimize(spirv.fragment, preset, fragment, log)) return GLProgram();
+
+	GLShader v_shader(resources, "vertex shader (SPIR-V)", GL_VERTEX_SHADER);
+	GLShader f_shader(resources, "fragment shader (SPIR-V)", GL_FRAGMENT_SHADER);
+	auto specialize = [&log](GLuint shader, const std::vector<uint32_t> &code, const char *stage)
+	{
+		glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, code.data(), GLsizei(code.size() * 4));
+		glSpecializeShaderARB(shader, "main", 0, nullptr, nullptr);
+		return ShaderBuild::compiled(shader, stage, log);
+	};
+	bool compiled = specialize(v_shader, vertex, "vertex");
+	compiled = specialize(f_shader, fragment, "fragment") && compiled;
+
+	GLProgram shader_program;
+	if(compiled) shader_program = linkProgram({v_shader, f_shader}, false, log);
+	if(shader_program) emit spirvReport(report);
+	fromSpirv = bool(shader_program);
+	return shader_program;
+}
+
+void GLWidget::compileCompute(std::string code, QString directory)
+{
+	withContext([this, code, directory]()
+	{
+		if(QString::fromStdString(code).trimmed().isEmpty())	// an empty compute editor turns the stage off
+		{
+			compute.release();
+			return;
+		}
+		if(!ComputeStage::supported())
+		{
+			emit shaderError("Compute shaders need OpenGL 4.3, select it in Edit > OpenGL version and restart.");
+			return;
+		}
+
+		QString log;
+		ComputeSpec spec;
+		if(!ComputeStage::parse(code, spec, log))
 		{
-			i.x /= max;
-			i.y /= max;
-			i.z /= max;
+			emit shaderError("In compute shader:\n" + log);
+			return;
 		}
+
+		std::string cc = assemble(GL_COMPUTE_SHADER, ComputeStage::withWorkgroup(code, spec), true, false);
+
+		GLShader c_shader(resources, "compute shader", GL_COMPUTE_SHADER);
+		ShaderBuild::compile(c_shader, cc);
+		GLProgram program;
+		if(ShaderBuild::compiled(c_shader, "compute", log)) program = linkProgram({c_shader}, false, log);
+
+		if(!program || !compute.setup(std::move(program), spec, directory, log))
+			emit shaderError(log);	// the previous compute stage keeps running
+		state.invalidate();	// buffer and texture setup bypasses the state tracker
+		if(runningSpirv && compute.hasImages()) replaceProgram(lastVertex, lastFragment);	// like a texture import
+	});
+}
+
+void GLWidget::compareShaders(std::string vA, std::string fA, std::string vB, std::string fB,
+							  BenchSettings settings)
+{
+	withContext([this, vA, fA, vB, fB, settings]()
+	{
+		comparison = {vA, fA, vB, fB, settings};
+		comparisonRequested = true;
+	});
+	// runs on the next frame, like the capture
+}
+
+void GLWidget::runComparison()
+{
+	comparisonRequested = false;
+
+	QString log;
+	GLProgram programA = buildProgram(comparison.vertexA, comparison.fragmentA, log);
+	GLProgram programB = buildProgram(comparison.vertexB, comparison.fragmentB, log);
+	if(!programA || !programB)
+	{
+		emit shaderError("Comparison failed:\n" + log);
+		return;
+	}
+
+	BenchResult result = ShaderBench::run(resources,
+				[this](GLuint program, GLfloat t, int w, int h) { drawScene(program, t, w, h); },
+				programA, programB, comparison.settings);
+	state.invalidate();	// the bench binds its framebuffer and renderbuffers behind the state tracker's back
+	state.bindFramebuffer(GL_FRAMEBUFFER, renderer->framebuffer());
+
+	state.forgetProgram(programA);
+	state.forgetProgram(programB);
+	emit comparisonReport(result.report());
+}
+
+void GLWidget::reset() { withContext([this]() { time = 0; }); }
+
+void GLWidget::setSpirvPreset(int preset) { withContext([this, preset]() { spirvPreset = preset; }); }
+
+void GLWidget::startCapture(CaptureSettings settings)
+{
+	withContext([this, settings]()
+	{
+		requestedCapture = settings;
+		captureRequested = true;
+	});
+	// the capture starts on the next frame, frames are only drawn while the preview is shown
 }
 
+void GLWidget::stopCapture()
+{
+	withContext([this]()
+	{
+		captureRequested = false;
+		if(capture->isActive()) capture->stop();
+	});
+}
+
+void GLWidget::startTrace(QString path)
+{
+	withContext([this, path]()
+	{
+		if(!state.startTrace(path)) emit shaderError("Could not write the call trace to " + path);
+	});
+}
+
+void GLWidget::stopTrace() { withContext([this]() { state.stopTrace(); }); }
+
 GLWidget::~GLWidget()
 {
+	window->removeEventFilter(this);
+	renderer->finish();	// releaseGL runs on the render thread, which owns the context
+}
 
+void GLWidget::releaseGL()
+{
+	if(capture->isActive())
+	{
+		capture->disconnect();
+		capture->stop();
+	}
+	textures.release();
+
+	state.forgetProgram(current_shader);
+	current_shader.reset();
+	state.forgetProgram(costProgram);
+	costProgram.reset();
+	heatmap.release(state);
+	scene.release();
+	compute.release();
+	builtIns.release();
+	resources.reportLeaks();	// anything still registered now was leaked by someone
 }
@@ -5,50 +5,161 @@
 #include <fstream>
 #include <sstream>
 #include <cstdio>
+#include <cmath>
+#include <algorithm>
 #include <QWidget>
 #include <QMatrix4x4>
 #include <QMessageBox>
 #include <GL/glew.h>
-#include <QOpenGLWidget>
+#include <QVBoxLayout>
+#include <QSet>
 #include <QTime>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QMouseEvent>
+#include <QHash>
+#include <QCryptographicHash>
+#include <functional>
+#include <map>
 #include "vec.h"
+#include "framecapture.h"
+#include "shaderbench.h"
+#include "texturemanager.h"
+#include "glstate.h"
+#include "glresource.h"
+#include "meshscene.h"
+#include "objmodel.h"
+#include "builtins.h"
+#include "spirvcompiler.h"
+#include "computestage.h"
+#include "startuptrace.h"
+#include "costheatmap.h"
+#include "renderthread.h"
+#include "shaderbuild.h"
+#include <initializer_list>
 
-class GLWidget : public QOpenGLWidget
+class GLWidget : public QWidget
 {
     Q_OBJECT
 public:
 	explicit GLWidget(QWidget *parent = nullptr);
     ~GLWidget();
 
+	struct FrameInput	// what the render thread needs to know about the window
+	{
+		int width = 1, height = 1;	// in pixels of the framebuffer
+		GLfloat mouse[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	};
+
+	struct FrameReport	// what the GUI thread gets to see of the renderer, after every frame and command
+	{
+		GLState::FrameStats stats;
+		unsigned frame = 0;
+		int liveCount[GLResources::KindCount] = {};
+		size_t liveBytes[GLResources::KindCount] = {};
+		size_t totalBytes = 0;
+		double computeMilliseconds = -1;
+		bool tracing = false, capturing = false;
+	};
+
 private:
-    GLuint current_shader;
+	/** CLARIFICATION:
+	 * The members below the window belong to the render thread (see renderthread.h): only the functions
+	 * that run there, initializeGL, paintGL, releaseGL and the work given to withContext, may use them.
+	 * The slots run on the GUI thread and hand everything over with withContext.
+	 **/
+	QWindow *window;
+	RenderThread *renderer;
+	FrameInput input;	// the GUI thread's copy, published whenever it changes
+	LatestValue<FrameInput> inputs;
+	LatestValue<FrameReport> reports;
+	QSet<QString> importedModels;	// GUI thread, to tell a first import from a reload
+
+	GLResources resources;	// declared first, everything below may own GL objects registered here
+    GLProgram current_shader;
     GLfloat time;
-	std::vector<vec3> verts;
-	std::vector<vec2> uvs;
-	std::vector<vec3> normals;
-	std::vector<unsigned> elems[3];
-	// element arrays for modelspace vertices, UVs and normals
-	GLuint vertexArray;
-	GLuint vertexBuffers[3];
-	GLuint elementBuffers[3];
-	GLuint texture;
-	bool hasUVs = false, hasNormals = false;
+	MeshScene scene;
+	int quad = -1;	// the default square, replaced by the first imported model
+	std::map<QString, std::vector<int>> models;	// meshes of every imported file, replaced when it is reloaded
+	TextureManager textures;
+	GLState state;
+	BuiltInUniforms builtIns;
+	QElapsedTimer frameTimer;
+	GLfloat deltaTime = 0.0f;
+	FrameInput view;	// the render thread's copy, taken at the start of every frame
+	ComputeStage compute;
+	CostHeatmap heatmap;
+	GLProgram costProgram;	// the instrumented or overdraw copy of the current program
+	int heatmapMode = CostHeatmap::Off;
+	GLfloat heatmapScale = 32.0f;
+	std::string lastVertex, lastFragment;	// sources of the current program
+	FrameCapture *capture;
+	CaptureSettings requestedCapture;
+	bool captureRequested = false;
+
+	struct Comparison
+	{
+		std::string vertexA, fragmentA, vertexB, fragmentB;
+		BenchSettings settings;
+	} comparison;
+	bool comparisonRequested = false;
+	int spirvPreset = -1;	// SpirvCompiler::Preset, or -1 to hand GLSL to the driver
+	bool runningSpirv = false;	// the current program was built from SPIR-V
+
+	QHash<QByteArray, QPair<GLenum, QByteArray>> programBinaries;	// linked programs by hash of their source
 
     void initializeGL();
     void paintGL();
-	void normalize();
+	void releaseGL();
+	void publishReport();
+	void drawScene(GLuint, GLfloat, int, int);
+	GLProgram linkProgram(std::initializer_list<GLuint>, bool retrievable, QString&);
+	BuiltIns builtInValues(GLfloat, int, int) const;
+	GLProgram buildProgram(const std::string&, const std::string&, QString&);
+	GLProgram buildSpirvProgram(const std::string&, const std::string&, QString&, bool &fromSpirv);
+	void replaceProgram(std::string, std::string);
+	void addQuad();
+	void withContext(std::function<void()>);
+	void runComparison();
+	void buildHeatmap();
 
 	// for testing:
 	QMatrix4x4 rotation;
 
 public slots:
     void compileShader(std::string, std::string);
+	void compileCompute(std::string, QString);
 	void reset();
-	void loadTexture(QString);
+	void setSpirvPreset(int);
+	void setHeatmap(int, float);
+	void loadTexture(QString, QStringList, int);
+	void reloadTexture(QString);
+	void setTextureBudget(int);
 	void loadModel(QString);
+	void clearModels();
+	void startCapture(CaptureSettings);
+	void stopCapture();
+	void compareShaders(std::string, std::string, std::string, std::string, BenchSettings);
+
+protected:
+	void showEvent(QShowEvent*);
+	bool eventFilter(QObject*, QEvent*);	// the window's resize, expose and mouse events
+
+public:
+	const FrameReport &frameReport() { return reports.latest(); }
+	bool isCapturing() { return frameReport().capturing; }
+	bool isTracing() { return frameReport().tracing; }
+	void startTrace(QString);	// a file that can't be written is reported through shaderError
+	void stopTrace();
+
+	static std::string assemble(GLenum stage, const std::string &code, bool multiDraw, bool spirv);
 
 signals:
     void shaderError(QString);
+	void captureProgress(int, int);
+	void captureFinished(QString);
+	void comparisonReport(QString);
+	void spirvReport(QString);
 };
 
 #endif // GLWIDGET_H
@@ -6,38 +6,47 @@ IDE::IDE(QWidget *parent) :
     ui(new Ui::IDE)
 {
     ui->setupUi(this);
+	StartupTrace::mark("main window layout");
     ui->splitter->setStretchFactor(0,1);
 	ui->splitter->setStretchFactor(1,1);
 
 	ui->splitter_2->setStretchFactor(0, 1);
     ui->splitter_2->setStretchFactor(1, 1);
 
-	openGLWidget = new GLWidget();
+	openGLWidget = new GLWidget();	// no GL work happens until the preview is first shown
 
 	currentFile = QStandardPaths::locate(QStandardPaths::HomeLocation, QString(),
 											  QStandardPaths::LocateDirectory);
 	// set current path to file to the home directory - makes browsing files easier
 
-	timer = new QTimer(this);
-	timer->start(1);
-	// make a timer for the GL widget
+	watcher = new AssetWatcher(this);
+	connect(watcher, SIGNAL(changed(int,QString)), this, SLOT(assetChanged(int,QString)));
+	// reloads the project, included files, textures and models when they change on disk
 
-	connect(timer, SIGNAL(timeout()), openGLWidget, SLOT(update()));
-	// GL widget updates every tick
+	about = nullptr;
+	statsView = nullptr;
+	// created the first time they're opened, the license file isn't read during startup
 
-    about = new About();
+	memoryLabel = new QLabel();
+	statusBar()->addPermanentWidget(memoryLabel);
+	memoryTimer = new QTimer(this);
+	connect(memoryTimer, SIGNAL(timeout()), this, SLOT(updateMemory()));
+	memoryTimer->start(1000);
+	// shows how much GPU memory the IDE's GL objects hold
 
     /** MENU ACTIONS **/
 
     connect(ui->actionFragmentEditor, SIGNAL(triggered()), ui->fragPlainTextEdit, SLOT(toggle()));
 	connect(ui->actionVertexEditor, SIGNAL(triggered()), ui->vertPlainTextEdit, SLOT(toggle()));
+	connect(ui->actionComputeEditor, SIGNAL(triggered()), ui->compPlainTextEdit, SLOT(toggle()));
 	// shows either editor pane when checking their corresponding menu option
+	ui->compPlainTextEdit->hide();	// most shaders don't need a compute stage
 
-    connect(ui->actionAbout, SIGNAL(triggered()), about, SLOT(show()));
-	// opens the about and license dialog
+	connect(ui->actionStatistics, SIGNAL(triggered()), this, SLOT(showStatistics()));
+	// shows per-frame GL call counts, state changes and uploads
 
-    connect(ui->actionExit, SIGNAL(triggered()), about, SLOT(close()));
-	// closes the program
+    connect(ui->actionAbout, SIGNAL(triggered()), this, SLOT(showAbout()));
+	// opens the about and license dialog
 
     connect(ui->actionRun, SIGNAL(triggered()), this, SLOT(sendStrings()));
 	// makes the main window send shader code to the GL widget
@@ -60,21 +69,53 @@ IDE::IDE(QWidget *parent) :
 	connect(ui->actionImport_model, SIGNAL(triggered()), this, SLOT(importModel()));
 	// imports a model
 
+	connect(ui->actionCapture, SIGNAL(triggered()), this, SLOT(captureSequence()));
+	// starts or stops exporting the shader animation as an image sequence
+
+	connect(ui->actionCompare, SIGNAL(triggered()), this, SLOT(compareWithFile()));
+	// measures the editor's shaders against the ones in a saved file
+
+	connect(ui->actionSpirv, SIGNAL(triggered()), this, SLOT(spirvPipeline()));
+	if(SpirvCompiler::available()) openGLWidget->setSpirvPreset(QSettings().value("spirvPreset", -1).toInt());
+	// compiles through glslang and the SPIR-V optimizer instead of the driver's GLSL compiler
+	StartupTrace::mark("menu actions and preview widget");
+
+	connect(ui->actionHeatmap, SIGNAL(triggered()), this, SLOT(costHeatmap()));
+	// shows where on screen the fragment shader spends its time, next to its output
+
     /** CONTEXT SPECIFIC **/
 
 	connect(this, SIGNAL(strings(std::string,std::string)),
 			openGLWidget, SLOT(compileShader(std::string,std::string)));
+	connect(this, SIGNAL(computeString(std::string,QString)),
+			openGLWidget, SLOT(compileCompute(std::string,QString)));
 	// directs the GL widget to compile the shader code
 
-	connect(this, SIGNAL(pathToTexture(QString)), openGLWidget, SLOT(loadTexture(QString)));
-	// sends path to texture file to the GL widget
+	connect(this, SIGNAL(pathToTexture(QString,QStringList,int)),
+			openGLWidget, SLOT(loadTexture(QString,QStringList,int)));
+	// sends the sampler name and paths to texture files to the GL widget
+
+	connect(ui->actionPreferences, SIGNAL(triggered()), this, SLOT(preferences()));
+	openGLWidget->setTextureBudget(QSettings().value("textureBudget", 512).toInt());
+	// memory the texture cache may keep for textures that aren't bound anymore
+
+	connect(ui->actionGLVersion, SIGNAL(triggered()), this, SLOT(glVersion()));
+	// compute shaders and multi-draw need a newer context than the default 3.3
 
 	connect(this, SIGNAL(pathToModel(QString)), openGLWidget, SLOT(loadModel(QString)));
+	connect(ui->actionClear_models, SIGNAL(triggered()), this, SLOT(clearModels()));
+	// removes every imported model and brings back the default square
+
+	connect(openGLWidget, SIGNAL(captureProgress(int,int)), this, SLOT(captureProgress(int,int)));
+	connect(openGLWidget, SIGNAL(captureFinished(QString)), this, SLOT(captureFinished(QString)));
+	// reports capture progress in the status bar
 
     /** ERROR OUTPUT **/
 
 	ui->textBrowser->hide();	// don't show the error pane by default
 	connect(openGLWidget, SIGNAL(shaderError(QString)), ui->textBrowser, SLOT(setPlainText(QString)));
+	connect(openGLWidget, SIGNAL(comparisonReport(QString)), ui->textBrowser, SLOT(setPlainText(QString)));
+	connect(openGLWidget, SIGNAL(spirvReport(QString)), ui->textBrowser, SLOT(setPlainText(QString)));
 	// sets text in the error pane if there was an error while compiling the shaders
 
     connect(ui->textBrowser, SIGNAL(textChanged()), ui->textBrowser, SLOT(show()));
@@ -82,114 +123,335 @@ IDE::IDE(QWidget *parent) :
 
 	vertexSyntaxHighlighter = new GLSLSyntax(ui->vertPlainTextEdit->document());
 	fragmentSyntaxHighlighter = new GLSLSyntax(ui->fragPlainTextEdit->document());
+	computeSyntaxHighlighter = new GLSLSyntax(ui->compPlainTextEdit->document());
+	StartupTrace::mark("syntax highlighting");
 }
 
-void IDE::open()
+void IDE::showAbout()
+{
+	if(!about)
+	{
+		about = new About();
+		connect(ui->actionExit, SIGNAL(triggered()), about, SLOT(close()));
+		// closes the about window along with the program
+	}
+	about->show();
+}
+
+void IDE::showStatistics()
 {
-	openGLWidget->close();
-	// not closing the GL widget causes the file dialog to be invisible - at least on my machine
+	if(!statsView) statsView = new StatsView(openGLWidget);
+	statsView->show();
+}
 
+void IDE::open()
+{
 	currentFile = QFileDialog::getOpenFileName(this, "Open GLSL file", currentFile,
 										"GLSL files (*.glsl);;Any files(*.*)"); // get file path
-	QFile file(currentFile); // get file handle
-
-	if(file.open(QFile::ReadOnly)) // see if file can be opened properly
+	GLSLFile project;
+	if(project.read(currentFile)) // see if file is a valid IDE-formatted file
 	{
-		ui->fragPlainTextEdit->clear();
-		ui->vertPlainTextEdit->clear();
-		// clear editors first
-
-		QTextStream inputStream(&file); // get file contents
-		QString line = inputStream.readLine(); // get first line
-
-		if(line == "GLSL_FILE") // check if file is a valid IDE-formatted file
-		{
-			line = inputStream.readLine();
-			if(line == "VERTEX_SHADER_BEGIN") // check if vertex shader exists
-			{
-				line = inputStream.readLine();
-				while(line != "VERTEX_SHADER_END") // if not reached end of vertex shader, write to editor
-				{
-					ui->vertPlainTextEdit->appendPlainText(line);
-					line = inputStream.readLine();
-				}
-			}
-
-			line = inputStream.readLine();
-			line = inputStream.readLine();
-			// there is a one-line gap between "VERTEX_SHADER_END" and "FRAGMENT_SHADER_BEGIN"
-
-			if(line == "FRAGMENT_SHADER_BEGIN") // same as above but for fragment shader
-			{
-				line = inputStream.readLine();
-				while(line != "FRAGMENT_SHADER_END")
-				{
-					ui->fragPlainTextEdit->appendPlainText(line);
-					line = inputStream.readLine();
-				}
-			}
-		}
-		file.close(); // finally, close the file
+		ui->vertPlainTextEdit->setPlainText(project.vertex);
+		ui->fragPlainTextEdit->setPlainText(project.fragment);
+		ui->compPlainTextEdit->setPlainText(project.compute);
+		if(!project.compute.isEmpty()) ui->compPlainTextEdit->show();
+		ui->actionComputeEditor->setChecked(ui->compPlainTextEdit->isVisible());
+		watcher->unwatch(AssetWatcher::Project);
+		watcher->watch(currentFile, AssetWatcher::Project);
 	}
 }
 
 void IDE::save()
 {
-	openGLWidget->close();
 	currentFile = QFileDialog::getSaveFileName(this, "Open GLSL file", currentFile,
 										"GLSL files (*.glsl);;Any files(*.*)");
-	QFile file(currentFile);
-	if(file.open(QFile::WriteOnly))
-	{
-		QTextStream outputStream(&file);
-		outputStream << "GLSL_FILE\n";
-		outputStream << "VERTEX_SHADER_BEGIN\n";
-		outputStream << ui->vertPlainTextEdit->toPlainText();
-		outputStream << "\nVERTEX_SHADER_END\n\n";
-		outputStream << "FRAGMENT_SHADER_BEGIN\n";
-		outputStream << ui->fragPlainTextEdit->toPlainText();
-		outputStream << "\nFRAGMENT_SHADER_END\n\n";
-		file.close();
-	}
+	GLSLFile project;
+	project.vertex = ui->vertPlainTextEdit->toPlainText();
+	project.fragment = ui->fragPlainTextEdit->toPlainText();
+	project.compute = ui->compPlainTextEdit->toPlainText();
+	if(!project.write(currentFile)) return;
+	ui->vertPlainTextEdit->document()->setModified(false);
+	ui->fragPlainTextEdit->document()->setModified(false);
+	ui->compPlainTextEdit->document()->setModified(false);
+	// the editors match the file again, so changes made to it elsewhere can be reloaded
+	watcher->unwatch(AssetWatcher::Project);
+	watcher->watch(currentFile, AssetWatcher::Project);
 }
 
 void IDE::sendStrings()
 {
+	QString vertex = ui->vertPlainTextEdit->toPlainText();
+	QString fragment = ui->fragPlainTextEdit->toPlainText();
+	QString compute = ui->compPlainTextEdit->toPlainText();
+	QStringList included;
+	QString directory = projectDirectory(currentFile), error;
+	if(!expandIncludes(vertex, fragment, currentFile, included)) return;
+	if(!GLSLFile::expandIncludes(compute, directory, included, error))
+	{
+		ui->textBrowser->setPlainText(error);
+		return;
+	}
+	watcher->unwatch(AssetWatcher::Include);
+	for(const QString &path : included) watcher->watch(path, AssetWatcher::Include);
+
 	ui->textBrowser->hide();
 	openGLWidget->show();
-	emit strings( ui->vertPlainTextEdit->toPlainText().toStdString(),
-				  ui->fragPlainTextEdit->toPlainText().toStdString() );
+	emit strings(vertex.toStdString(), fragment.toStdString());
+	emit computeString(compute.toStdString(), directory);	// buffers and images named in it are read from there
+}
+
+QString IDE::projectDirectory(const QString &projectPath)
+{
+	QFileInfo project(projectPath);
+	return project.isDir() ? project.absoluteFilePath() : project.absolutePath();
+}
+
+bool IDE::expandIncludes(QString &vertex, QString &fragment, const QString &projectPath, QStringList &included)
+{
+	QString directory = projectDirectory(projectPath);
+	// includes are looked up next to the project file
+
+	QString error;
+	if(GLSLFile::expandIncludes(vertex, directory, included, error)
+			&& GLSLFile::expandIncludes(fragment, directory, included, error)) return true;
+	ui->textBrowser->setPlainText(error);
+	return false;
 }
 
 void IDE::importTexture()
 {
-	openGLWidget->close();
-	QString texturePath = QFileDialog::getOpenFileName(this, "Import texture", "",
-													   "BMP files (*.bmp);;"
-														"GIF files (*.gif);;"
-														"JPEG files (*.jpg, *.jpeg);;"
-														"PNG files (*.png);;"
-														"XBM files (*.xbm);;"
-														"XPM files (*.xpm);;"
+	QStringList texturePaths = QFileDialog::getOpenFileNames(this, "Import texture", "",
+													   "Images (*.bmp *.gif *.jpg *.jpeg *.png *.xbm *.xpm);;"
+													   "Block-compressed textures (*.dds *.ktx2);;"
 													   "All files (*.*)");
-	emit pathToTexture(texturePath);	// forward the file path to the GL widget
+	if(texturePaths.isEmpty()) return;
+
+	bool ok;
+	QString slot = QInputDialog::getText(this, "Import texture", "Sampler uniform:",
+										 QLineEdit::Normal, "tex", &ok);
+	if(!ok || slot.isEmpty()) return;
+	// the texture is bound to the sampler uniform with this name
+
+	int kind = TextureManager::Texture2D;	// .dds and .ktx2 files describe their own layout
+	if(texturePaths.size() > 1)
+	{
+		QStringList kinds;
+		kinds << "2D array (one layer per file)" << "Cubemap (+X, -X, +Y, -Y, +Z, -Z)";
+		QString choice = QInputDialog::getItem(this, "Import texture", "Combine files into:", kinds, 0, false, &ok);
+		if(!ok) return;
+		kind = choice == kinds[0] ? TextureManager::TextureArray : TextureManager::Cubemap;
+	}
+
+	emit pathToTexture(slot, texturePaths, kind);	// forward the file paths to the GL widget
+	for(const QString &path : texturePaths) watcher->watch(path, AssetWatcher::Texture);
+}
+
+void IDE::preferences()
+{
+	bool ok;
+	int budget = QInputDialog::getInt(this, "Preferences", "Texture cache budget (MB):",
+									  QSettings().value("textureBudget", 512).toInt(), 16, 65536, 64, &ok);
+	if(!ok) return;
+	QSettings().setValue("textureBudget", budget);
+	openGLWidget->setTextureBudget(budget);
+}
+
+void IDE::glVersion()
+{
+	QStringList versions;
+	versions << "3.3" << "4.3" << "4.5" << "4.6";
+	QString current = QSettings().value("glVersion", "3.3").toString();
+
+	bool ok;
+	QString version = QInputDialog::getItem(this, "OpenGL version", "Context version (4.3 or newer for compute shaders):",
+											versions, qMax(0, versions.indexOf(current)), false, &ok);
+	if(!ok || version == current) return;
+	QSettings().setValue("glVersion", version);
+	statusBar()->showMessage("The OpenGL " + version + " context is created the next time the IDE starts");
+	// the context is created once, before the first frame, so the change needs a restart
 }
 
 void IDE::importModel()
 {
-	openGLWidget->close();
-	QString modelPath = QFileDialog::getOpenFileName(this, "Import model", "",
-													   "OBJ files (*.obj);;"
-													   "All files (*.*)");
-	emit pathToModel(modelPath);	// forward the file path to the GL widget
+	QStringList modelPaths = QFileDialog::getOpenFileNames(this, "Import model", "",
+														   "OBJ files (*.obj);;"
+														   "All files (*.*)");
+	for(const QString &modelPath : modelPaths)
+	{
+		emit pathToModel(modelPath);	// forward the file paths to the GL widget, each one is added to the scene
+		watcher->watch(modelPath, AssetWatcher::Model);
+	}
+}
+
+void IDE::clearModels()
+{
+	watcher->unwatch(AssetWatcher::Model);
+	openGLWidget->clearModels();
+}
+
+void IDE::assetChanged(int kind, QString path)
+{
+	switch(kind)
+	{
+	case AssetWatcher::Project:
+	{
+		GLSLFile project;
+		if(!project.read(path)) return;
+		if(project.vertex == ui->vertPlainTextEdit->toPlainText()
+				&& project.fragment == ui->fragPlainTextEdit->toPlainText()
+				&& project.compute == ui->compPlainTextEdit->toPlainText()) return;	// most likely our own save
+		if(ui->vertPlainTextEdit->document()->isModified() || ui->fragPlainTextEdit->document()->isModified()
+				|| ui->compPlainTextEdit->document()->isModified())
+		{
+			statusBar()->showMessage(path + " changed on disk, keeping the unsaved edits");
+			return;
+		}
+		ui->vertPlainTextEdit->setPlainText(project.vertex);
+		ui->fragPlainTextEdit->setPlainText(project.fragment);
+		ui->compPlainTextEdit->setPlainText(project.compute);
+		statusBar()->showMessage("Reloaded " + path, 3000);
+		if(openGLWidget->isVisible()) sendStrings();	// the running shader is only replaced if this compiles
+		break;
+	}
+	case AssetWatcher::Include:
+		statusBar()->showMessage("Reloaded " + path, 3000);
+		if(openGLWidget->isVisible()) sendStrings();
+		break;
+	case AssetWatcher::Texture:
+		openGLWidget->reloadTexture(path);	// only the slots using this file are decoded and uploaded again
+		break;
+	case AssetWatcher::Model:
+		emit pathToModel(path);	// replaces the meshes from this file, the rest of the scene stays
+		break;
+	}
+}
+
+void IDE::captureSequence()
+{
+	if(openGLWidget->isCapturing())	// triggering the action again cancels the capture
+	{
+		openGLWidget->stopCapture();
+		return;
+	}
+
+	CaptureDialog dialog(this);
+	if(dialog.exec() != QDialog::Accepted) return;
+
+	openGLWidget->startCapture(dialog.settings());
+	openGLWidget->show();	// capture frames are drawn along with the preview's, which keeps running behind dialogs
+	statusBar()->showMessage("Capturing...");
+}
+
+void IDE::captureProgress(int written, int total)
+{
+	statusBar()->showMessage("Captured " + QString::number(written) + " of "
+							 + QString::number(total) + " frames");
+}
+
+void IDE::captureFinished(QString message)
+{
+	statusBar()->showMessage(message);
+}
+
+void IDE::compareWithFile()
+{
+	QString path = QFileDialog::getOpenFileName(this, "Compare with GLSL file", currentFile,
+												"GLSL files (*.glsl);;Any files(*.*)");
+	if(path == "") return;
+
+	GLSLFile project;
+	if(!project.read(path))
+	{
+		ui->textBrowser->setPlainText(path + " is not a GLSL project file.");
+		return;
+	}
+
+	bool ok;
+	BenchSettings settings;
+	settings.frames = QInputDialog::getInt(this, "Compare shaders", "Frames per shader:",
+										   settings.frames, 10, 100000, 10, &ok);
+	if(!ok) return;
+	settings.nameA = "editor";
+	settings.nameB = path;
+
+	QString vertex = ui->vertPlainTextEdit->toPlainText();
+	QString fragment = ui->fragPlainTextEdit->toPlainText();
+	QStringList included, includedB;
+	if(!expandIncludes(vertex, fragment, currentFile, included)
+			|| !expandIncludes(project.vertex, project.fragment, path, includedB)) return;
+
+	ui->textBrowser->hide();
+	openGLWidget->show();
+	openGLWidget->compareShaders(vertex.toStdString(), fragment.toStdString(),
+								 project.vertex.toStdString(), project.fragment.toStdString(),
+								 settings);
+	// the report shows up in the output pane once the comparison has run
+}
+
+void IDE::spirvPipeline()
+{
+	if(!SpirvCompiler::available())
+	{
+		ui->textBrowser->setPlainText("This build has no SPIR-V support, rebuild with \"qmake CONFIG+=spirv\" "
+									  "and glslang and SPIRV-Tools installed.");
+		return;
+	}
+
+	QStringList choices;
+	choices << "Off (the driver compiles GLSL)";
+	for(int preset = 0; preset < SpirvCompiler::PresetCount; ++preset)
+		choices << QString("SPIR-V, ") + SpirvCompiler::presetName(SpirvCompiler::Preset(preset));
+
+	bool ok;
+	int current = QSettings().value("spirvPreset", -1).toInt() + 1;
+	QString choice = QInputDialog::getItem(this, "SPIR-V pipeline", "Compile shaders with:", choices, current, false, &ok);
+	if(!ok) return;
+
+	int preset = choices.indexOf(choice) - 1;
+	QSettings().setValue("spirvPreset", preset);
+	openGLWidget->setSpirvPreset(preset);
+	sendStrings();	// recompile right away, the instruction counts show up in the output pane
+}
+
+void IDE::costHeatmap()
+{
+	QStringList modes;
+	modes << "Off" << "Shader cost (loop iterations and branches taken)" << "Overdraw (fragments per pixel)";
+
+	bool ok;
+	QString choice = QInputDialog::getItem(this, "Cost heatmap", "Show next to the output:", modes, 1, false, &ok);
+	if(!ok) return;
+	int mode = modes.indexOf(choice);
+
+	int scale = 1;
+	if(mode != CostHeatmap::Off)
+	{
+		scale = QInputDialog::getInt(this, "Cost heatmap", "Count shown in red:",
+									 mode == CostHeatmap::Cost ? 32 : 8, 1, 1000000, 1, &ok);
+		if(!ok) return;
+		statusBar()->showMessage("Heatmap: black is 0, then blue, green, yellow, and red for "
+								 + QString::number(scale) + " or more");
+	}
+	else statusBar()->clearMessage();
+
+	openGLWidget->setHeatmap(mode, scale);
+	sendStrings();	// the heatmap is built along with the shader
+}
+
+void IDE::updateMemory()
+{
+	memoryLabel->setText("GPU memory: " + QString::number(
+							 openGLWidget->frameReport().totalBytes/1048576.0, 'f', 1) + " MB");
 }
 
 IDE::~IDE()
 {
-	timer->stop();
+	memoryTimer->stop();
 	delete vertexSyntaxHighlighter;
 	delete fragmentSyntaxHighlighter;
-    delete timer;
+	delete computeSyntaxHighlighter;
     delete about;
+	delete statsView;
+	delete openGLWidget;	// tears down the GL context, reporting any GL objects that leaked
     delete ui;
 }
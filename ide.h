@@ -7,9 +7,19 @@
 #include <QTimer>
 #include <QFileDialog>
 #include <QStandardPaths>
+#include <QStatusBar>
+#include <QInputDialog>
+#include <QSettings>
+#include <QLabel>
+#include <QFileInfo>
 #include "glwidget.h"
 #include "glslsyntax.h"
 #include "about.h"
+#include "capturedialog.h"
+#include "glslfile.h"
+#include "statsview.h"
+#include "assetwatcher.h"
+#include "startuptrace.h"
 
 namespace Ui {
 class IDE;
@@ -25,11 +35,17 @@ public:
 
 private:
     Ui::IDE *ui;
-    QTimer *timer;
     About *about;
+	StatsView *statsView;
+	QLabel *memoryLabel;
+	QTimer *memoryTimer;
     QString currentFile;
 	GLWidget *openGLWidget;
-	GLSLSyntax *vertexSyntaxHighlighter, *fragmentSyntaxHighlighter;
+	GLSLSyntax *vertexSyntaxHighlighter, *fragmentSyntaxHighlighter, *computeSyntaxHighlighter;
+	AssetWatcher *watcher;
+
+	static QString projectDirectory(const QString &projectPath);
+	bool expandIncludes(QString&, QString&, const QString &projectPath, QStringList&);
 
 public slots:
     void open();
@@ -37,10 +53,24 @@ public slots:
 	void sendStrings();
 	void importTexture();
 	void importModel();
+	void clearModels();
+	void assetChanged(int, QString);
+	void captureSequence();
+	void captureProgress(int, int);
+	void captureFinished(QString);
+	void compareWithFile();
+	void spirvPipeline();
+	void costHeatmap();
+	void preferences();
+	void showAbout();
+	void showStatistics();
+	void glVersion();
+	void updateMemory();
 
 signals:
     void strings(std::string, std::string);
-	void pathToTexture(QString);
+	void computeString(std::string, QString);
+	void pathToTexture(QString, QStringList, int);
 	void pathToModel(QString);
 };
 
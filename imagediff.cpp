@@ -0,0 +1,167 @@
+#include "imagediff.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGEDIFF_SSE2
+#include <emmintrin.h>
+#endif
+
+static const int weights[4] = {54, 183, 19, 0};	// luma weights out of 256, alpha doesn't show
+
+struct Totals
+{
+	int maxError = 0;
+	uint64_t squares = 0;
+	size_t visible = 0;
+};
+
+static void compareScalar(const unsigned char *a, const unsigned char *b, size_t pixels, int limit, Totals &totals)
+{
+	for(size_t p = 0; p < pixels; ++p, a += 4, b += 4)
+	{
+		int weighted = 0;
+		for(int c = 0; c < 4; ++c)
+		{
+			int difference = std::abs(int(a[c]) - int(b[c]));
+			totals.maxError = std::max(totals.maxError, difference);
+			totals.squares += difference * difference;
+			weighted += difference * weights[c];
+		}
+		if(weighted > limit) ++totals.visible;
+	}
+}
+
+#ifdef IMAGEDIFF_SSE2
+static void compareSSE2(const unsigned char *a, const unsigned char *b, size_t pixels, int limit, Totals &totals)
+{
+	/** CLARIFICATION:
+	 * 16 bytes are 4 RGBA pixels. |a - b| of unsigned bytes is the OR of both saturated subtractions,
+	 * one of which is always 0. For the squares and the weighted sum the differences are widened to 16 bits,
+	 * and _mm_madd_epi16 multiplies and adds neighbouring pairs: with the weights that gives r*wr + g*wg and
+	 * b*wb + a*0 in two 32-bit lanes per pixel, which the shuffle adds together. The squares are kept in
+	 * 32-bit lanes for at most 4096 steps (4096 * 2 * 2 * 255^2 doesn't overflow) and then moved to 64 bits.
+	 **/
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i weight = _mm_setr_epi16(weights[0], weights[1], weights[2], weights[3],
+										  weights[0], weights[1], weights[2], weights[3]);
+	const __m128i threshold = _mm_set1_epi32(limit);
+	__m128i maximum = zero;
+
+	size_t steps = pixels / 4;
+	for(size_t done = 0; done < steps;)
+	{
+		size_t block = std::min<size_t>(steps - done, 4096);
+		__m128i squares = zero;
+		for(size_t i = 0; i < block; ++i, a += 16, b += 16)
+		{
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+			__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+			__m128i difference = _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+			maximum = _mm_max_epu8(maximum, difference);
+
+			__m128i low = _mm_unpacklo_epi8(difference, zero);	// pixels 0 and 1
+			__m128i high = _mm_unpackhi_epi8(difference, zero);	// pixels 2 and 3
+			squares = _mm_add_epi32(squares, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+
+			__m128i weightedLow = _mm_madd_epi16(low, weight);
+			__m128i weightedHigh = _mm_madd_epi16(high, weight);
+			weightedLow = _mm_add_epi32(weightedLow, _mm_shuffle_epi32(weightedLow, _MM_SHUFFLE(2, 3, 0, 1)));
+			weightedHigh = _mm_add_epi32(weightedHigh, _mm_shuffle_epi32(weightedHigh, _MM_SHUFFLE(2, 3, 0, 1)));
+			// lanes 0 and 1 hold the first pixel's sum, lanes 2 and 3 the second one's
+
+			int visibleLow = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(weightedLow, threshold)));
+			int visibleHigh = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(weightedHigh, threshold)));
+			totals.visible += (visibleLow & 1) + ((visibleLow >> 2) & 1) + (visibleHigh & 1) + ((visibleHigh >> 2) & 1);
+		}
+
+		alignas(16) uint32_t lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanes), squares);
+		totals.squares += uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		done += block;
+	}
+
+	alignas(16) unsigned char bytes[16];
+	_mm_store_si128(reinterpret_cast<__m128i*>(bytes), maximum);
+	for(unsigned char byte : bytes) totals.maxError = std::max(totals.maxError, int(byte));
+
+	compareScalar(a, b, pixels % 4, limit, totals);	// the last few pixels
+}
+#endif
+
+DiffResult ImageDiff::compare(const unsigned char *a, const unsigned char *b, size_t pixels, int threshold)
+{
+	Totals totals;
+	int limit = threshold * 256;	// the weights add up to 256
+#ifdef IMAGEDIFF_SSE2
+	compareSSE2(a, b, pixels, limit, totals);
+#else
+	compareScalar(a, b, pixels, limit, totals);
+#endif
+
+	DiffResult result;
+	result.maxError = totals.maxError;
+	result.rmse = pixels ? std::sqrt(double(totals.squares) / (pixels * 4)) : 0;
+	result.visiblePixels = totals.visible;
+	result.pixels = pixels;
+	return result;
+}
+
+DiffResult ImageDiff::compare(const QImage &a, const QImage &b, int threshold)
+{
+	QImage x = a.convertToFormat(QImage::Format_RGBA8888), y = b.convertToFormat(QImage::Format_RGBA8888);
+	if(x.size() != y.size())	// every pixel counts as different
+	{
+		DiffResult result;
+		result.maxError = 255;
+		result.rmse = 255;
+		result.pixels = result.visiblePixels = size_t(std::max(x.width(), y.width())) * std::max(x.height(), y.height());
+		return result;
+	}
+	return compare(x.constBits(), y.constBits(), size_t(x.width()) * x.height(), threshold);
+	// RGBA8888 rows are 4-byte aligned already, so the image is one contiguous array
+}
+
+QImage ImageDiff::heatmap(const QImage &reference, const QImage &actual, int threshold)
+{
+	QImage x = reference.convertToFormat(QImage::Format_RGBA8888), y = actual.convertToFormat(QImage::Format_RGBA8888);
+	QImage map(y.size(), QImage::Format_RGBA8888);
+	if(x.size() != y.size()) x = x.scaled(y.size());
+	// only written for failed comparisons, so there is no need to vectorize it
+
+	for(int row = 0; row < map.height(); ++row)
+	{
+		const unsigned char *a = x.constScanLine(row), *b = y.constScanLine(row);
+		unsigned char *out = map.scanLine(row);
+		for(int column = 0; column < map.width(); ++column, a += 4, b += 4, out += 4)
+		{
+			int weighted = 0;
+			for(int c = 0; c < 3; ++c) weighted += std::abs(int(a[c]) - int(b[c])) * weights[c];
+			if(weighted <= threshold * 256)	// the same test as compare(), passing pixels show the reference dimmed
+			{
+				unsigned char luma = (a[0] * weights[0] + a[1] * weights[1] + a[2] * weights[2]) / 1024;
+				out[0] = out[1] = out[2] = luma;
+			}
+			else	// red for small differences, through orange to yellow for the largest
+			{
+				out[0] = 255;
+				out[1] = static_cast<unsigned char>(std::min(255, weighted / 128));
+				out[2] = 0;
+			}
+			out[3] = 255;
+		}
+	}
+	return map;
+}
+
+bool ImageDiff::vectorized()
+{
+#ifdef IMAGEDIFF_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,39 @@
+#ifndef IMAGEDIFF_H
+#define IMAGEDIFF_H
+
+#include <cstddef>
+#include <QImage>
+
+/** CLARIFICATION:
+ * Compares two RGBA8 images of the same size. Three numbers come out of it:
+ *
+ * - the largest difference of a single channel (0-255)
+ * - the root mean square difference over every channel
+ * - how many pixels are visibly different: the per-channel differences are weighted like luma
+ *   (0.21 red, 0.72 green, 0.07 blue, alpha ignored) and a pixel counts when the result is above
+ *   the threshold. Green changes show up more than blue ones, and alpha doesn't show up at all.
+ *
+ * Regression runs compare a lot of pixels, so where the compiler targets SSE2 (every x86-64 build)
+ * 4 pixels are compared per step, otherwise one at a time. Both give exactly the same numbers.
+ **/
+
+struct DiffResult
+{
+	int maxError = 0;
+	double rmse = 0;
+	size_t visiblePixels = 0;	// above the perceptual threshold
+	size_t pixels = 0;
+
+	double visibleFraction() const { return pixels ? double(visiblePixels) / pixels : 0; }
+};
+
+class ImageDiff
+{
+public:
+	static DiffResult compare(const unsigned char *a, const unsigned char *b, size_t pixels, int threshold);
+	static DiffResult compare(const QImage &a, const QImage &b, int threshold);
+	static QImage heatmap(const QImage &reference, const QImage &actual, int threshold);
+	static bool vectorized();
+};
+
+#endif // IMAGEDIFF_H
@@ -1,17 +1,150 @@
 #include "ide.h"
+#include "batchvalidator.h"
+#include "regressionrunner.h"
+#include "parametersweep.h"
+#include "startuptrace.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <QSettings>
+#include <QTextStream>
+#include <cstring>
 
 int main(int argc, char *argv[])
 {
+	bool trace = false;
+	for(int i = 1; i < argc; ++i) trace = trace || std::strcmp(argv[i], "--startup-trace") == 0;
+	StartupTrace::start(trace);
+
     QSurfaceFormat format;
-	format.setVersion(3, 3);	// set context to GL 3.3
+	QStringList version = QSettings("Qt-Shader-IDE", "Qt_GLSL_IDE").value("glVersion", "3.3").toString().split('.');
+	format.setVersion(version.value(0).toInt(), version.value(1).toInt());	// GL 3.3 unless changed in Edit > OpenGL version
 	format.setProfile(QSurfaceFormat::CoreProfile);	// set context to core profile
 	format.setSwapInterval(1);	// ensure that vsync is enabled
 	QSurfaceFormat::setDefaultFormat(format);	// apply the settings above
 	QCoreApplication::addLibraryPath(".");	// if libraries exist in the current folder, look for them
+
+	bool validate = false, regress = false, sweep = false, software = false;
+	for(int i = 1; i < argc; ++i)
+	{
+		validate = validate || std::strcmp(argv[i], "--validate") == 0;
+		regress = regress || std::strcmp(argv[i], "--regress") == 0;
+		sweep = sweep || std::strcmp(argv[i], "--sweep") == 0;
+		software = software || std::strcmp(argv[i], "--software") == 0;
+	}
+	if(software)
+	{
+		qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+		qputenv("GALLIUM_DRIVER", "llvmpipe");
+		// Mesa reads these when the first context is created, so they have to be set before anything else
+	}
+
+	if(validate)	// no widgets, so it also runs with "-platform offscreen" on machines without a display
+	{
+		QGuiApplication a(argc, argv);
+		QCommandLineParser parser;
+		parser.setApplicationDescription("Compiles and links every .glsl project in a folder.");
+		parser.addHelpOption();
+		parser.addOption(QCommandLineOption("validate", "Folder to validate, searched recursively.", "folder"));
+		parser.addOption(QCommandLineOption("jobs", "Number of worker threads (default: one per core).", "count", "0"));
+		parser.addOption(QCommandLineOption("glslang", "Check with glslang instead of the GL driver."));
+		parser.addOption(QCommandLineOption("software", "Use Mesa's llvmpipe software renderer."));
+		parser.process(a);
+		return BatchValidator::run(parser.value("validate"), parser.value("jobs").toInt(), parser.isSet("glslang"));
+	}
+
+	if(regress)
+	{
+		QGuiApplication a(argc, argv);
+		QCommandLineParser parser;
+		parser.setApplicationDescription("Renders every .glsl project in a folder and compares it with reference images.");
+		parser.addHelpOption();
+		parser.addOption(QCommandLineOption("regress", "Folder of projects, searched recursively.", "folder"));
+		parser.addOption(QCommandLineOption("references", "Reference images and timings (default: <folder>/references).", "folder"));
+		parser.addOption(QCommandLineOption("output", "Where renders and heatmaps of failed images go (default: <folder>/regression-output).", "folder"));
+		parser.addOption(QCommandLineOption("update", "Write new reference images and timings instead of comparing."));
+		parser.addOption(QCommandLineOption("times", "Comma separated time values to render at.", "list", "0,1,5"));
+		parser.addOption(QCommandLineOption("size", "Image size.", "WxH", "640x360"));
+		parser.addOption(QCommandLineOption("threshold", "Weighted difference (0-255) below which pixels count as the same.", "value", "8"));
+		parser.addOption(QCommandLineOption("tolerance", "Fraction of visibly different pixels an image may have.", "fraction", "0.001"));
+		parser.addOption(QCommandLineOption("frames", "Timed frames per project.", "count", "60"));
+		parser.addOption(QCommandLineOption("slowdown", "Allowed GPU time increase over the baseline.", "fraction", "0.25"));
+		parser.addOption(QCommandLineOption("software", "Use Mesa's llvmpipe software renderer."));
+		parser.process(a);
+
+		RegressionSettings settings;
+		settings.directory = parser.value("regress");
+		settings.references = parser.isSet("references") ? parser.value("references") : settings.directory + "/references";
+		settings.output = parser.isSet("output") ? parser.value("output") : settings.directory + "/regression-output";
+		settings.times.clear();
+		for(const QString &time : parser.value("times").split(',', QString::SkipEmptyParts)) settings.times.push_back(time.toFloat());
+		QStringList size = parser.value("size").split('x');
+		settings.width = qMax(1, size.value(0).toInt());
+		settings.height = qMax(1, size.value(1).toInt());
+		settings.threshold = parser.value("threshold").toInt();
+		settings.tolerance = parser.value("tolerance").toDouble();
+		settings.frames = qMax(1, parser.value("frames").toInt());
+		settings.slowdown = parser.value("slowdown").toDouble();
+		settings.update = parser.isSet("update");
+		return RegressionRunner::run(settings);
+	}
+
+	if(sweep)
+	{
+		QGuiApplication a(argc, argv);
+		QCommandLineParser parser;
+		parser.setApplicationDescription("Renders every combination of shader parameters and reports which trade time for quality best.");
+		parser.addHelpOption();
+		parser.addOption(QCommandLineOption("sweep", "Project to sweep.", "project"));
+		parser.addOption(QCommandLineOption("param", "Parameter and its values: NAME=1,2,4 or NAME=first:last[:step] or NAME=first:last:*factor. Repeatable.", "NAME=values"));
+		parser.addOption(QCommandLineOption("reference", "Value a parameter has in the reference images (default: its largest). Repeatable.", "NAME=value"));
+		parser.addOption(QCommandLineOption("times", "Comma separated time values to render at.", "list", "0,1,5"));
+		parser.addOption(QCommandLineOption("size", "Image size.", "WxH", "640x360"));
+		parser.addOption(QCommandLineOption("frames", "Timed frames per combination.", "count", "60"));
+		parser.addOption(QCommandLineOption("cache", "Results cache (default: <project>.sweep.json).", "file"));
+		parser.addOption(QCommandLineOption("csv", "Also write the results as CSV.", "file"));
+		parser.addOption(QCommandLineOption("software", "Use Mesa's llvmpipe software renderer."));
+		parser.process(a);
+
+		SweepSettings settings;
+		settings.project = parser.value("sweep");
+		for(const QString &text : parser.values("param"))
+		{
+			SweepParameter parameter;
+			QString error;
+			if(!SweepParameter::parse(text, parameter, error))
+			{
+				QTextStream(stderr) << error << "\n";
+				return 2;
+			}
+			settings.parameters.push_back(parameter);
+		}
+		settings.reference = parser.values("reference");
+		settings.times.clear();
+		for(const QString &time : parser.value("times").split(',', QString::SkipEmptyParts)) settings.times.push_back(time.toFloat());
+		QStringList size = parser.value("size").split('x');
+		settings.width = qMax(1, size.value(0).toInt());
+		settings.height = qMax(1, size.value(1).toInt());
+		settings.frames = qMax(1, parser.value("frames").toInt());
+		settings.cache = parser.value("cache");
+		settings.csv = parser.value("csv");
+		return ParameterSweep::run(settings);
+	}
+
     QApplication a(argc, argv);
+	a.setOrganizationName("Qt-Shader-IDE");
+	a.setApplicationName("Qt_GLSL_IDE");	// used by QSettings to store preferences
+	StartupTrace::mark("QApplication");
     IDE w;
+	StartupTrace::mark("IDE constructed");
     w.show();
+	StartupTrace::mark("main window shown");
+	QTimer::singleShot(0, []()
+	{
+		StartupTrace::mark("first event loop pass");
+		StartupTrace::finish();
+	});
+	// the first pass paints the window, after that the editor takes input
 
     return a.exec();
 }
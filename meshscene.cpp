@@ -0,0 +1,306 @@
+#include "meshscene.h"
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+
+static const size_t initialVertices = 1 << 14, initialIndices = 1 << 16;
+
+void RangeAllocator::reset(size_t capacity)
+{
+	ranges.clear();
+	if(capacity) ranges[0] = capacity;
+	total = capacity;
+	inUse = 0;
+}
+
+void RangeAllocator::grow(size_t capacity)
+{
+	if(capacity <= total) return;
+	size_t oldTotal = total;
+	total = capacity;
+	insert(oldTotal, capacity - oldTotal);	// the new space joins a free range at the end if there is one
+}
+
+bool RangeAllocator::allocate(size_t size, size_t &offset)
+{
+	for(auto range = ranges.begin(); range != ranges.end(); ++range)
+	{
+		if(range->second < size) continue;
+		offset = range->first;
+		if(range->second > size) ranges[range->first + size] = range->second - size;
+		ranges.erase(range);
+		inUse += size;
+		return true;
+	}
+	return false;
+}
+
+void RangeAllocator::free(size_t offset, size_t size)
+{
+	if(size == 0) return;
+	inUse -= size;
+	insert(offset, size);
+}
+
+void RangeAllocator::insert(size_t offset, size_t size)
+{
+	auto next = ranges.lower_bound(offset);
+	if(next != ranges.begin())
+	{
+		auto previous = std::prev(next);
+		if(previous->first + previous->second == offset)	// merge with the range before
+		{
+			offset = previous->first;
+			size += previous->second;
+			ranges.erase(previous);
+		}
+	}
+	if(next != ranges.end() && offset + size == next->first)	// and with the one after
+	{
+		size += next->second;
+		ranges.erase(next);
+	}
+	ranges[offset] = size;
+}
+
+MeshScene::MeshScene(GLResources &resources) : resources(resources) {}
+
+bool MeshScene::multiDrawSupported()
+{
+	if(!GLEW_VERSION_4_3) return false;
+	GLint vertexBlocks = 0;
+	glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+	return vertexBlocks > 0;
+	// 4.3 only promises storage blocks to fragment and compute shaders, the model matrices are read per vertex
+}
+
+void MeshScene::create(GLState &state)
+{
+	multiDraw = multiDrawSupported();	// indirect draws with base instance and storage buffers
+
+	vertexArray = GLVertexArray(resources, "scene vertex array");
+	vertexSpace.reset(0);
+	indexSpace.reset(0);
+	grow(state, vertices, 0, initialVertices * sizeof(vbo), "scene vertices");
+	grow(state, indices, 0, initialIndices * sizeof(GLuint), "scene indices");
+	vertexSpace.grow(initialVertices);
+	indexSpace.grow(initialIndices);
+
+	if(multiDraw)
+	{
+		drawIDs = GLBuffer(resources, "scene draw IDs");
+		matrices = GLBuffer(resources, "scene model matrices");
+		commands = GLBuffer(resources, "scene draw commands");
+		drawIDCount = 0;
+	}
+	pointAttributes(state);
+	dirty = true;
+}
+
+void MeshScene::grow(GLState &state, GLBuffer &buffer, size_t oldBytes, size_t newBytes, const QString &label)
+{
+	GLBuffer bigger(resources, label);
+	state.bindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+	state.bufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+	bigger.setSize(newBytes);
+
+	if(oldBytes)
+	{
+		state.bindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+	}
+	buffer = std::move(bigger);	// the old buffer is deleted here, the copy is ordered before that by GL
+}
+
+void MeshScene::pointAttributes(GLState &state)
+{
+	state.bindVertexArray(vertexArray);
+	state.bindBuffer(GL_ARRAY_BUFFER, vertices);
+	state.enableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vbo), (void*)offsetof(vbo, vertex));
+	state.enableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vbo), (void*)offsetof(vbo, uv));
+	state.enableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vbo), (void*)offsetof(vbo, normal));
+	// model-space position, UV and normal are interleaved in one buffer
+
+	if(multiDraw)
+	{
+		state.bindBuffer(GL_ARRAY_BUFFER, drawIDs);
+		state.enableVertexAttribArray(3);
+		glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, 0, 0);
+		glVertexAttribDivisor(3, 1);	// one value per instance, selected by each command's baseInstance
+	}
+
+	state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+	// attribute pointers remember the buffer they were set with, so this is redone whenever a buffer grows
+}
+
+int MeshScene::add(GLState &state, const MeshPart &part, const QMatrix4x4 &model)
+{
+	if(part.vertices.empty() || part.indices.empty()) return -1;
+
+	Mesh mesh;
+	mesh.name = QString::fromStdString(part.name);
+	mesh.vertexCount = part.vertices.size();
+	mesh.indexCount = part.indices.size();
+	mesh.model = model;
+
+	bool repoint = false;
+	while(!vertexSpace.allocate(mesh.vertexCount, mesh.firstVertex))
+	{
+		size_t capacity = vertexSpace.capacity();
+		size_t bigger = std::max(capacity * 2, capacity + mesh.vertexCount);
+		grow(state, vertices, capacity * sizeof(vbo), bigger * sizeof(vbo), "scene vertices");
+		vertexSpace.grow(bigger);
+		repoint = true;
+	}
+	while(!indexSpace.allocate(mesh.indexCount, mesh.firstIndex))
+	{
+		size_t capacity = indexSpace.capacity();
+		size_t bigger = std::max(capacity * 2, capacity + mesh.indexCount);
+		grow(state, indices, capacity * sizeof(GLuint), bigger * sizeof(GLuint), "scene indices");
+		indexSpace.grow(bigger);
+		repoint = true;
+	}
+	if(repoint) pointAttributes(state);
+
+	state.bindBuffer(GL_COPY_WRITE_BUFFER, vertices);
+	state.bufferSubData(GL_COPY_WRITE_BUFFER, mesh.firstVertex * sizeof(vbo),
+						mesh.vertexCount * sizeof(vbo), part.vertices.data());
+	state.bindBuffer(GL_COPY_WRITE_BUFFER, indices);
+	state.bufferSubData(GL_COPY_WRITE_BUFFER, mesh.firstIndex * sizeof(GLuint),
+						mesh.indexCount * sizeof(GLuint), part.indices.data());
+	// indices stay relative to the mesh, the base vertex of the draw moves them to its range
+
+	meshes[nextId] = mesh;
+	dirty = true;
+	return nextId++;
+}
+
+void MeshScene::remove(int id)
+{
+	auto mesh = meshes.find(id);
+	if(mesh == meshes.end()) return;
+	vertexSpace.free(mesh->second.firstVertex, mesh->second.vertexCount);
+	indexSpace.free(mesh->second.firstIndex, mesh->second.indexCount);
+	meshes.erase(mesh);
+	dirty = true;
+}
+
+void MeshScene::setModelMatrix(int id, const QMatrix4x4 &model)
+{
+	auto mesh = meshes.find(id);
+	if(mesh == meshes.end()) return;
+	mesh->second.model = model;
+	dirty = true;
+}
+
+void MeshScene::clear()
+{
+	meshes.clear();
+	vertexSpace.reset(vertexSpace.capacity());
+	indexSpace.reset(indexSpace.capacity());
+	dirty = true;
+	// the buffers keep their size, the next import will most likely need it again
+}
+
+void MeshScene::updateDrawData(GLState &state)
+{
+	std::vector<DrawCommand> drawCommands;
+	std::vector<GLfloat> models;
+	drawCommands.reserve(meshes.size());
+	models.reserve(meshes.size() * 16);
+	for(const auto &mesh : meshes)
+	{
+		DrawCommand command;
+		command.count = GLuint(mesh.second.indexCount);
+		command.instanceCount = 1;
+		command.firstIndex = GLuint(mesh.second.firstIndex);
+		command.baseVertex = GLint(mesh.second.firstVertex);
+		command.baseInstance = GLuint(drawCommands.size());
+		drawCommands.push_back(command);
+		models.insert(models.end(), mesh.second.model.constData(), mesh.second.model.constData() + 16);
+	}
+
+	state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands);
+	state.bufferData(GL_DRAW_INDIRECT_BUFFER, drawCommands.size() * sizeof(DrawCommand),
+					 drawCommands.data(), GL_DYNAMIC_DRAW);
+	commands.setSize(drawCommands.size() * sizeof(DrawCommand));
+
+	state.bindBuffer(GL_SHADER_STORAGE_BUFFER, matrices);
+	state.bufferData(GL_SHADER_STORAGE_BUFFER, models.size() * sizeof(GLfloat), models.data(), GL_DYNAMIC_DRAW);
+	matrices.setSize(models.size() * sizeof(GLfloat));
+
+	if(drawCommands.size() > drawIDCount)	// the draw IDs are just 0..n-1, they only change when there are more
+	{
+		drawIDCount = std::max(drawCommands.size(), drawIDCount * 2);
+		std::vector<GLuint> ids(drawIDCount);
+		for(size_t i = 0; i < ids.size(); ++i) ids[i] = GLuint(i);
+		state.bindBuffer(GL_ARRAY_BUFFER, drawIDs);
+		state.bufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+		drawIDs.setSize(ids.size() * sizeof(GLuint));
+	}
+	dirty = false;
+}
+
+void MeshScene::draw(GLState &state, GLuint program)
+{
+	if(meshes.empty()) return;
+	state.bindVertexArray(vertexArray);
+
+	if(multiDraw)
+	{
+		if(dirty) updateDrawData(state);
+		state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, matrices);
+		state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands);
+		state.multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, GLsizei(meshes.size()), 0);
+		return;
+	}
+
+	GLint location = state.uniformLocation(program, "modelMatrix");
+	for(const auto &mesh : meshes)
+	{
+		state.uniformMatrix4fv(location, mesh.second.model.constData());
+		state.drawElementsBaseVertex(GL_TRIANGLES, GLsizei(mesh.second.indexCount), GL_UNSIGNED_INT,
+									 (void*)(mesh.second.firstIndex * sizeof(GLuint)),
+									 GLint(mesh.second.firstVertex));
+	}
+}
+
+MeshPart MeshScene::square()
+{
+	MeshPart square;
+	square.name = "square";
+	square.vertices.push_back(vbo(-1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f));
+	square.vertices.push_back(vbo(1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f));
+	square.vertices.push_back(vbo(-1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f));
+	square.vertices.push_back(vbo(1.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f));
+	square.indices = {0, 1, 2, 2, 1, 3};
+	return square;
+}
+
+const char *MeshScene::glslVersion(bool multiDraw)
+{
+	return multiDraw ? "#version 430 core\n" : "#version 330 core\n";	// storage buffers need 4.3
+}
+
+std::string MeshScene::declarations(GLenum stage, bool multiDraw)
+{
+	if(stage != GL_VERTEX_SHADER) return "";
+	if(!multiDraw) return "uniform mat4 modelMatrix;\n";
+	return "layout(location = 3) in uint sceneDrawID;\n"
+		   "layout(std430, binding = 0) readonly buffer SceneModelMatrices { mat4 sceneModelMatrices[]; };\n"
+		   "#define modelMatrix sceneModelMatrices[sceneDrawID]\n";
+}
+
+void MeshScene::release()
+{
+	meshes.clear();
+	vertexArray.reset();
+	vertices.reset();
+	indices.reset();
+	drawIDs.reset();
+	matrices.reset();
+	commands.reset();
+}
@@ -0,0 +1,100 @@
+#ifndef MESHSCENE_H
+#define MESHSCENE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <QString>
+#include <QMatrix4x4>
+#include <GL/glew.h>
+#include "objmodel.h"
+#include "glresource.h"
+#include "glstate.h"
+
+/** CLARIFICATION:
+ * All meshes of the scene share one big vertex buffer and one big index buffer. RangeAllocator hands out
+ * ranges of them (in vertices and indices, not bytes), first fit, and merges ranges back together when
+ * meshes are removed. When a buffer is full it is replaced by one twice as large, and the old contents
+ * are copied over on the GPU.
+ **/
+
+class RangeAllocator
+{
+public:
+	void reset(size_t capacity);
+	void grow(size_t capacity);
+	bool allocate(size_t size, size_t &offset);
+	void free(size_t offset, size_t size);
+	size_t capacity() const { return total; }
+	size_t used() const { return inUse; }
+
+private:
+	std::map<size_t, size_t> ranges;	// free ranges, offset to size
+	size_t total = 0, inUse = 0;
+
+	void insert(size_t offset, size_t size);
+};
+
+/** CLARIFICATION:
+ * On GL 4.3 the whole scene is one glMultiDrawElementsIndirect call: every mesh is a command in the
+ * indirect buffer, and its baseInstance picks its draw index from an instanced attribute, which the
+ * vertex shader uses to read the mesh's model matrix from a shader storage buffer. On GL 3.3 the same
+ * buffers are drawn with a glDrawElementsBaseVertex per mesh and the model matrix is a plain uniform.
+ * Shaders don't see the difference, both ways end up with a "modelMatrix" in the vertex shader.
+ **/
+
+class MeshScene
+{
+public:
+	explicit MeshScene(GLResources&);
+
+	// the functions below need the GL context to be current
+	void create(GLState&);
+	int add(GLState&, const MeshPart&, const QMatrix4x4 &model = QMatrix4x4());
+	void remove(int);
+	void setModelMatrix(int, const QMatrix4x4&);
+	void clear();
+	void draw(GLState&, GLuint program);
+	void release();
+
+	static MeshPart square();	// the default mesh, a square covering the whole viewport
+	static bool multiDrawSupported();	// needs the GL context to be current
+	static const char *glslVersion(bool multiDraw);
+	static std::string declarations(GLenum stage, bool multiDraw);
+	bool usesMultiDraw() const { return multiDraw; }
+	int meshCount() const { return int(meshes.size()); }
+	size_t vertexCount() const { return vertexSpace.used(); }
+	size_t indexCount() const { return indexSpace.used(); }
+
+private:
+	struct Mesh
+	{
+		QString name;
+		size_t firstVertex, vertexCount, firstIndex, indexCount;
+		QMatrix4x4 model;
+	};
+
+	struct DrawCommand	// layout defined by GL for indirect draws
+	{
+		GLuint count, instanceCount, firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	GLResources &resources;
+	std::map<int, Mesh> meshes;
+	int nextId = 0;
+	bool multiDraw = false, dirty = true;
+	RangeAllocator vertexSpace, indexSpace;
+	size_t drawIDCount = 0;
+
+	GLVertexArray vertexArray;
+	GLBuffer vertices, indices;
+	GLBuffer drawIDs, matrices, commands;	// only used for multi-draw
+
+	void grow(GLState&, GLBuffer&, size_t oldBytes, size_t newBytes, const QString &label);
+	void pointAttributes(GLState&);
+	void updateDrawData(GLState&);
+};
+
+#endif // MESHSCENE_H
@@ -0,0 +1,152 @@
+#include "objmodel.h"
+#include <map>
+#include <tuple>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+bool ObjModel::load(const std::string &path)
+{
+	/** CLARIFICATION:
+	 * An .obj file contains different vertices, indices and faces on every line in the following way:
+	 * - If a line begins with "v", then that is a modelspace vertex coordinate
+	 * - If a line begins with "vt", then that is a UV coordinate for texture mapping
+	 * - If a line begins with "vn", then that is a vertex normal coordinate for lighting
+	 * - If a line begins with "o" or "g", then a new object (part of the assembly) starts
+	 * - If a line begins with "f", then that is a face, which is made up of multiple vertices.
+	 *	Every vertex of a face can have 4 different formats: "v", "v/vt", "v/vt/vn" or "v//vn",
+	 *	and negative indices count back from the last coordinate read so far.
+	 *
+	 * OBJ indexes positions, UVs and normals separately, while GL has a single index per vertex.
+	 * Every distinct v/vt/vn combination of a part therefore becomes one packed vertex.
+	 **/
+
+	std::ifstream file(path);	// open file located at "path"
+	if(!file) return false;
+
+	parts.clear();
+	hasUVs = hasNormals = false;
+
+	std::vector<vec3> positions, normals;
+	std::vector<vec2> uvs;
+	std::map<std::tuple<int, int, int>, unsigned> known;	// v/vt/vn combination to vertex of the current part
+
+	auto part = [&]() -> MeshPart&
+	{
+		if(parts.empty()) parts.push_back(MeshPart());
+		return parts.back();
+	};
+
+	auto resolve = [](long index, size_t count) -> int
+	{
+		if(index > 0) return int(index - 1);
+		if(index < 0) return int(count) + int(index);
+		return -1;	// missing
+	};
+
+	std::string line;	// declare a string that will hold the contents of every line in the file
+	while(std::getline(file, line))
+	{
+		std::stringstream lineStream(line);	// make a stream from the string to tokenize it
+		std::string token;
+		lineStream >> token;	// tokenize to see what the first argument of a line is
+		if(token == "v")	// look for vertex coordinates first
+		{
+			vec3 tempVertex(0, 0, 0);
+			lineStream >> tempVertex.x >> tempVertex.y >> tempVertex.z;
+			positions.push_back(tempVertex);	// put the coordinates in the buffer
+		}
+		else if(token == "vt")	// look for UV coordinates
+		{
+			hasUVs = true;
+			vec2 tempVertex(0, 0);
+			lineStream >> tempVertex.x >> tempVertex.y;
+			uvs.push_back(tempVertex);
+		}
+		else if(token == "vn")
+		{
+			hasNormals = true;
+			vec3 tempVertex(0, 0, 0);
+			lineStream >> tempVertex.x >> tempVertex.y >> tempVertex.z;
+			normals.push_back(tempVertex);
+		}
+		else if(token == "o" || token == "g")
+		{
+			MeshPart next;
+			std::getline(lineStream >> std::ws, next.name);
+			if(!parts.empty() && parts.back().indices.empty()) parts.back() = next;	// nothing drawn yet, rename
+			else parts.push_back(next);
+			known.clear();
+		}
+		else if(token == "f")
+		{
+			/** CLARIFICATION:
+				 * The face is considered to be convex and as if it was drawn using GL_TRIANGLE_FAN,
+				 * so it is split into adjacent triangles that all share the first vertex.
+				 **/
+
+			std::vector<unsigned> face;
+			std::string corner;
+			while(lineStream >> corner)
+			{
+				const char *c = corner.c_str();
+				char *end;
+				long v = std::strtol(c, &end, 10), vt = 0, vn = 0;
+				if(*end == '/')
+				{
+					c = end + 1;
+					vt = std::strtol(c, &end, 10);	// stays 0 for "v//vn"
+					if(*end == '/') vn = std::strtol(end + 1, &end, 10);
+				}
+
+				auto key = std::make_tuple(resolve(v, positions.size()), resolve(vt, uvs.size()),
+										   resolve(vn, normals.size()));
+				if(std::get<0>(key) < 0 || std::get<0>(key) >= int(positions.size())) return false;
+
+				auto found = known.find(key);
+				if(found == known.end())
+				{
+					vbo vertex;
+					vertex.vertex = positions[std::get<0>(key)];
+					vertex.uv = std::get<1>(key) >= 0 && std::get<1>(key) < int(uvs.size())
+							? uvs[std::get<1>(key)] : vec2(0, 0);
+					vertex.normal = std::get<2>(key) >= 0 && std::get<2>(key) < int(normals.size())
+							? normals[std::get<2>(key)] : vec3(0, 0, 0);
+					part().vertices.push_back(vertex);
+					found = known.emplace(key, unsigned(part().vertices.size() - 1)).first;
+				}
+				face.push_back(found->second);
+			}
+
+			for(size_t i = 2; i < face.size(); ++i)
+			{
+				part().indices.push_back(face[0]);
+				part().indices.push_back(face[i - 1]);
+				part().indices.push_back(face[i]);
+			}
+		}
+	}
+
+	if(!parts.empty() && parts.back().indices.empty()) parts.pop_back();	// trailing group without faces
+	return !parts.empty();
+}
+
+void ObjModel::normalize()
+{
+	float max = 0.0f;
+	for(const auto &part : parts)
+		for(const auto &i : part.vertices)
+		{
+			if(i.vertex.x > max) max = i.vertex.x;
+			if(i.vertex.y > max) max = i.vertex.y;
+			if(i.vertex.z > max) max = i.vertex.z;
+		}
+	if(max > 1.0f)	// the whole model is scaled at once, so the parts stay in place relative to each other
+		for(auto &part : parts)
+			for(auto &&i : part.vertices)
+			{
+				i.vertex.x /= max;
+				i.vertex.y /= max;
+				i.vertex.z /= max;
+			}
+}
@@ -0,0 +1,24 @@
+#ifndef OBJMODEL_H
+#define OBJMODEL_H
+
+#include <string>
+#include <vector>
+#include "vec.h"
+
+struct MeshPart
+{
+	std::string name;
+	std::vector<vbo> vertices;	// modelspace position, UV and normal packed together
+	std::vector<unsigned> indices;
+};
+
+struct ObjModel
+{
+	std::vector<MeshPart> parts;	// one per "o" or "g" block of the file
+	bool hasUVs = false, hasNormals = false;
+
+	bool load(const std::string&);
+	void normalize();
+};
+
+#endif // OBJMODEL_H
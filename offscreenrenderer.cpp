@@ -0,0 +1,196 @@
+#include "offscreenrenderer.h"
+#include <QElapsedTimer>
+#include "glwidget.h"
+#include "shaderbench.h"
+#include "shaderbuild.h"
+
+OffscreenRenderer::OffscreenRenderer(int width, int height)
+	: scene(resources), builtIns(resources), compute(resources), width(width), height(height)
+{
+	state.invalidate();
+	scene.create(state);
+	scene.add(state, MeshScene::square());
+	builtIns.create(state);
+
+	framebuffer = GLFramebuffer(resources, "offscreen framebuffer");
+	colorBuffer = GLRenderbuffer(resources, "offscreen color");
+	depthBuffer = GLRenderbuffer(resources, "offscreen depth");
+	query = GLQuery(resources, "offscreen timer");
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	state.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+	state.enable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	state.enable(GL_DEPTH_TEST);
+	state.enable(GL_DEPTH_CLAMP);
+	glDepthRange(0.0001f, 100.0f);
+	glDepthFunc(GL_LESS);
+	state.clearColor(0, 0, 0, 1);
+	// the same state as the GL widget
+}
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+	program.reset();
+	compute.release();
+	scene.release();
+	builtIns.release();
+	query.reset();
+	framebuffer.reset();
+	colorBuffer.reset();
+	depthBuffer.reset();
+	resources.reportLeaks();
+}
+
+GLProgram OffscreenRenderer::build(std::initializer_list<std::pair<GLenum, std::string>> stages, QString &log)
+{
+	GLProgram linked(resources, "offscreen program");
+	std::vector<GLShader> shaders;
+	std::vector<GLuint> names;
+	for(const auto &stage : stages)
+	{
+		shaders.emplace_back(resources, "offscreen shader", stage.first);
+		ShaderBuild::compile(shaders.back(), stage.second);
+		names.push_back(shaders.back());
+	}
+	bool compiled = true;
+	for(size_t i = 0; i < shaders.size(); ++i)
+		compiled = ShaderBuild::compiled(shaders[i], ShaderBuild::stageName(stages.begin()[i].first), log) && compiled;
+	if(!compiled) return GLProgram();
+
+	ShaderBuild::link(linked, names);
+	if(!ShaderBuild::linked(linked, log)) return GLProgram();
+	BuiltInUniforms::bindBlock(linked);
+	return linked;
+}
+
+bool OffscreenRenderer::load(const GLSLFile &project, const QString &directory, QString &log)
+{
+	state.forgetProgram(program);
+	uniforms.clear();
+	program = build({{GL_VERTEX_SHADER, GLWidget::assemble(GL_VERTEX_SHADER, project.vertex.toStdString(),
+															 scene.usesMultiDraw(), false)},
+					 {GL_FRAGMENT_SHADER, GLWidget::assemble(GL_FRAGMENT_SHADER, project.fragment.toStdString(),
+															 scene.usesMultiDraw(), false)}}, log);
+	active = program;
+	if(!program) return false;
+
+	compute.release();	// every project starts from its own initial buffers
+	if(project.compute.trimmed().isEmpty()) return true;
+	if(!ComputeStage::supported())
+	{
+		log += "The compute shader needs an OpenGL 4.3 context.";
+		return false;
+	}
+
+	ComputeSpec spec;
+	std::string code = project.compute.toStdString();
+	if(!ComputeStage::parse(code, spec, log)) return false;
+	GLProgram computeProgram = build({{GL_COMPUTE_SHADER, GLWidget::assemble(GL_COMPUTE_SHADER,
+												ComputeStage::withWorkgroup(code, spec), true, false)}}, log);
+	bool ready = computeProgram && compute.setup(std::move(computeProgram), spec, directory, log);
+	state.invalidate();	// compute setup bypasses the state tracker
+	return ready;
+}
+
+void OffscreenRenderer::setProgram(GLuint replacement)
+{
+	uniforms.clear();	// their locations belong to the old program
+	state.forgetProgram(replacement);	// the name may have belonged to a program that was deleted since
+	active = replacement;
+}
+
+bool OffscreenRenderer::setUniform(const QString &name, double value)
+{
+	GLint count = 0;
+	glGetProgramiv(active, GL_ACTIVE_UNIFORMS, &count);
+	for(GLint i = 0; i < count; ++i)	// the type decides between glUniform1i and glUniform1f
+	{
+		GLchar found[256];
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(active, GLuint(i), sizeof(found), nullptr, &size, &type, found);
+		if(name != found) continue;
+		bool integer = type == GL_INT || type == GL_UNSIGNED_INT || type == GL_BOOL;
+		if(!integer && type != GL_FLOAT) return false;	// only scalars can be swept
+		uniforms.push_back({glGetUniformLocation(active, found), integer, value});
+		return true;
+	}
+	return false;	// not declared, or optimized away because nothing uses it
+}
+
+void OffscreenRenderer::draw(GLfloat time, bool timed)
+{
+	BuiltIns values;
+	values.date[0] = 2000;
+	values.date[1] = 1;
+	values.date[2] = 1;
+	values.resolution[0] = width;
+	values.resolution[1] = height;
+	values.time = time;
+	values.deltaTime = 1.0f/60.0f;
+	values.frame = int(time * 60.0f + 0.5f);
+	// everything else stays 0, like the mouse
+
+	state.beginFrame();
+	builtIns.nextFrame();
+	state.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	if(compute.isActive())
+	{
+		builtIns.update(state, values);
+		compute.dispatch(state);
+	}
+	if(timed) glBeginQuery(GL_TIME_ELAPSED, query);	// the compute stage times itself, queries can't overlap
+
+	state.viewport(0, 0, width, height);
+	state.clearDepth(1);
+	state.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	state.useProgram(active);
+	for(const Uniform &uniform : uniforms)
+	{
+		if(uniform.integer) state.uniform1i(uniform.location, GLint(uniform.value));
+		else state.uniform1f(uniform.location, GLfloat(uniform.value));
+	}
+	compute.bind(state, active, 0);
+	builtIns.update(state, values);
+	scene.draw(state, active);
+	compute.drawPoints(state);
+	if(timed) glEndQuery(GL_TIME_ELAPSED);
+	state.endFrame();
+}
+
+QImage OffscreenRenderer::render(GLfloat time)
+{
+	draw(time);
+	QImage image(width, height, QImage::Format_RGBA8888);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
+	return image.mirrored();	// GL starts at the bottom row
+}
+
+double OffscreenRenderer::time(GLfloat at, int frames, double &cpu)
+{
+	std::vector<double> gpuTimes, cpuTimes;
+	for(int i = -5; i < frames; ++i)	// a few frames to warm up first
+	{
+		QElapsedTimer timer;
+		timer.start();
+		draw(at, true);
+		glFinish();
+		double cpuTime = timer.nsecsElapsed() / 1e6;
+
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuTime);
+		if(i < 0) continue;
+		gpuTimes.push_back(gpuTime / 1e6);
+		cpuTimes.push_back(cpuTime);
+	}
+	cpu = ShaderBench::summarize(cpuTimes).median;
+	return ShaderBench::summarize(gpuTimes).median;
+}
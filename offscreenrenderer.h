@@ -0,0 +1,69 @@
+#ifndef OFFSCREENRENDERER_H
+#define OFFSCREENRENDERER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <initializer_list>
+#include <QString>
+#include <QImage>
+#include <GL/glew.h>
+#include "glresource.h"
+#include "glstate.h"
+#include "meshscene.h"
+#include "builtins.h"
+#include "computestage.h"
+#include "glslfile.h"
+
+/** CLARIFICATION:
+ * The GL widget's drawScene without the widget: the same scene (the default square), built-in uniform
+ * block and compute stage, drawing into a framebuffer of a fixed size. The command line tools use it,
+ * on one thread with the context current the whole time, so it has its own resources and state tracker.
+ *
+ * Everything that varies between runs is pinned: the built-in date is 2000-01-01, the mouse is at 0,
+ * and frame and deltaTime follow from the time at 60 frames per second. Textures aren't part of project
+ * files, so samplers read black.
+ **/
+
+class OffscreenRenderer
+{
+public:
+	OffscreenRenderer(int width, int height);
+	~OffscreenRenderer();
+
+	bool load(const GLSLFile&, const QString &directory, QString &log);	// program and compute stage
+	void setProgram(GLuint);	// a program built elsewhere, which has to outlive its use here
+	bool setUniform(const QString &name, double value);	// kept for every draw, false if there is none
+	QImage render(GLfloat time);
+	double time(GLfloat time, int frames, double &cpu);	// median GPU milliseconds
+
+	GLResources &registry() { return resources; }
+	bool usesMultiDraw() const { return scene.usesMultiDraw(); }
+	double computeMilliseconds() const { return compute.isActive() ? compute.milliseconds() : -1; }
+
+private:
+	struct Uniform
+	{
+		GLint location;
+		bool integer;
+		double value;
+	};
+
+	GLResources resources;
+	GLState state;
+	MeshScene scene;
+	BuiltInUniforms builtIns;
+	ComputeStage compute;
+	GLProgram program;	// the one load() built
+	GLuint active = 0;
+	std::vector<Uniform> uniforms;
+	GLFramebuffer framebuffer;
+	GLRenderbuffer colorBuffer, depthBuffer;
+	GLQuery query;
+	int width, height;
+
+	GLProgram build(std::initializer_list<std::pair<GLenum, std::string>>, QString &log);
+	void draw(GLfloat time, bool timed = false);
+};
+
+#endif // OFFSCREENRENDERER_H
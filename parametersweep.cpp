@@ -0,0 +1,406 @@
+#include "parametersweep.h"
+#include <map>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QTextStream>
+#include <QRegularExpression>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include "glslfile.h"
+#include "glwidget.h"
+#include "imagediff.h"
+#include "offscreenrenderer.h"
+#include "shaderbuild.h"
+
+bool SweepParameter::parse(const QString &text, SweepParameter &parameter, QString &error)
+{
+	parameter = SweepParameter();
+	int equals = text.indexOf('=');
+	if(equals <= 0)
+	{
+		error = "Expected NAME=values, not \"" + text + "\"";
+		return false;
+	}
+	parameter.name = text.left(equals).trimmed();
+	QString values = text.mid(equals + 1).trimmed();
+	error = "Can't read the values \"" + values + "\" of " + parameter.name;
+
+	bool ok = true;
+	if(values.contains(':'))	// first:last, first:last:step or first:last:*factor
+	{
+		QStringList range = values.split(':');
+		if(range.size() > 3) return false;
+		bool geometric = range.size() == 3 && range[2].startsWith('*');
+		double first = range[0].toDouble(&ok), last = ok ? range[1].toDouble(&ok) : 0;
+		double step = range.size() < 3 || !ok ? 1 : range[2].mid(geometric ? 1 : 0).toDouble(&ok);
+		if(!ok || last < first || (geometric ? step <= 1 || first <= 0 : step <= 0)) return false;
+
+		for(int i = 0; i <= 1000; ++i)
+		{
+			double value = geometric ? first * std::pow(step, i) : first + i * step;
+			if(value > last + 1e-9 * std::abs(last)) break;	// so rounding doesn't lose the last value
+			parameter.values.push_back(value);
+		}
+	}
+	else for(const QString &value : values.split(',', QString::SkipEmptyParts))
+	{
+		parameter.values.push_back(value.toDouble(&ok));
+		if(!ok) return false;
+	}
+
+	if(parameter.values.empty() || parameter.values.size() > 1000) return false;
+	error.clear();
+	return true;
+}
+
+static QRegularExpression defineLine(const QString &name)
+{
+	return QRegularExpression("^(\\s*#\\s*define\\s+" + QRegularExpression::escape(name) + ")(?=\\s|$).*$",
+							  QRegularExpression::MultilineOption);
+	// "#define NAME value", but not a function-like "#define NAME(x)"
+}
+
+static QString literal(double value)
+{
+	if(value == std::floor(value) && std::abs(value) < 1e9) return QString::number(qint64(value));
+	return QString::number(value, 'g', 9);
+	// whole numbers stay integers, so they can be loop bounds and array sizes
+}
+
+struct SweepPoint
+{
+	std::vector<double> values;
+	QByteArray key;	// cache key
+	int program = -1;	// index of its variant among the compiled programs
+	bool cached = false, failed = false;
+	double gpu = 0, rmse = 0, visible = 0;
+};
+
+static std::vector<GLProgram> compileAll(GLResources &resources, const std::vector<std::pair<std::string, std::string>> &sources,
+										 std::vector<QString> &logs)
+{
+	/** CLARIFICATION:
+	 * Everything is compiled and linked before any result is asked for. With the parallel compile extensions
+	 * the driver works on all of them on its own threads; even without, drivers that compile in the background
+	 * get the chance to overlap them. Asking for the link status is what waits for each one to finish.
+	 **/
+
+#ifdef GL_KHR_parallel_shader_compile
+	if(GLEW_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);	// as many as it wants
+#endif
+#ifdef GL_ARB_parallel_shader_compile
+	if(!GLEW_KHR_parallel_shader_compile && GLEW_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+#endif
+
+	std::vector<GLProgram> programs;
+	std::vector<GLShader> shaders;
+	for(const auto &source : sources)
+	{
+		programs.emplace_back(resources, "sweep program");
+		shaders.emplace_back(resources, "sweep shader", GL_VERTEX_SHADER);
+		shaders.emplace_back(resources, "sweep shader", GL_FRAGMENT_SHADER);
+		ShaderBuild::compile(shaders[shaders.size() - 2], source.first);
+		ShaderBuild::compile(shaders.back(), source.second);
+		ShaderBuild::link(programs.back(), {shaders[shaders.size() - 2], shaders.back()});
+	}
+
+	logs.assign(sources.size(), QString());
+	for(size_t p = 0; p < programs.size(); ++p)
+	{
+		bool compiled = ShaderBuild::compiled(shaders[p * 2], "vertex", logs[p]);
+		compiled = ShaderBuild::compiled(shaders[p * 2 + 1], "fragment", logs[p]) && compiled;
+		// when a stage didn't compile, its log says why the link failed
+		if(compiled && ShaderBuild::linked(programs[p], logs[p])) BuiltInUniforms::bindBlock(programs[p]);
+		else programs[p].reset();
+	}
+	return programs;
+}
+
+int ParameterSweep::run(const SweepSettings &settings)
+{
+	QTextStream out(stdout), err(stderr);
+	std::vector<SweepParameter> parameters = settings.parameters;
+	std::vector<GLfloat> times = settings.times;
+	if(times.empty()) times.push_back(0.0f);
+	if(parameters.empty())
+	{
+		err << "Nothing to sweep, add parameters with --param NAME=values.\n";
+		return 2;
+	}
+
+	GLSLFile project;
+	QStringList included;
+	QString error, folder = QFileInfo(settings.project).absolutePath();
+	if(!project.read(settings.project))
+	{
+		err << settings.project << " is not a GLSL project file.\n";
+		return 2;
+	}
+	if(!GLSLFile::expandIncludes(project.vertex, folder, included, error)
+			|| !GLSLFile::expandIncludes(project.fragment, folder, included, error))
+	{
+		err << error << "\n";
+		return 2;
+	}
+	if(!project.compute.trimmed().isEmpty())	// its buffers would carry over from one combination to the next
+	{
+		err << "Projects with a compute stage can't be swept.\n";
+		return 2;
+	}
+
+	std::vector<double> reference;
+	for(SweepParameter &parameter : parameters)
+	{
+		parameter.define = defineLine(parameter.name).match(project.vertex).hasMatch()
+				|| defineLine(parameter.name).match(project.fragment).hasMatch();
+		reference.push_back(*std::max_element(parameter.values.begin(), parameter.values.end()));
+	}
+	for(const QString &assignment : settings.reference)
+	{
+		SweepParameter given;
+		auto named = std::find_if(parameters.begin(), parameters.end(), [&assignment](const SweepParameter &p)
+		{ return assignment.section('=', 0, 0).trimmed() == p.name; });
+		if(!SweepParameter::parse(assignment, given, error) || named == parameters.end() || given.values.size() != 1)
+		{
+			err << "Can't use the reference \"" << assignment << "\", expected NAME=value for a swept parameter.\n";
+			return 2;
+		}
+		reference[named - parameters.begin()] = given.values[0];
+	}
+
+	std::vector<SweepPoint> points(1);	// every combination, like an odometer
+	for(const SweepParameter &parameter : parameters)
+	{
+		std::vector<SweepPoint> grown;
+		for(const SweepPoint &point : points)
+			for(double value : parameter.values)
+			{
+				grown.push_back(point);
+				grown.back().values.push_back(value);
+			}
+		points.swap(grown);
+	}
+	if(points.size() > 10000)
+	{
+		err << points.size() << " combinations are too many, narrow the ranges down.\n";
+		return 2;
+	}
+
+	QOffscreenSurface surface;
+	surface.create();
+	QOpenGLContext context;
+	if(!context.create() || !context.makeCurrent(&surface))
+	{
+		err << "Could not create a GL context.\n";
+		return 2;
+	}
+	glewExperimental = GL_TRUE;
+	glewInit();
+	QString renderer = QString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+	QString cachePath = settings.cache.isEmpty() ? settings.project + ".sweep.json" : settings.cache;
+	QFile cacheFile(cachePath);
+	QJsonObject cache;
+	if(cacheFile.open(QFile::ReadOnly)) cache = QJsonDocument::fromJson(cacheFile.readAll()).object();
+	cacheFile.close();
+
+	int failed = 0;
+	{
+		OffscreenRenderer render(settings.width, settings.height);
+
+		typedef std::pair<std::string, std::string> Source;
+		auto variant = [&](const std::vector<double> &values, QByteArray &key)
+		{
+			QString vertex = project.vertex, fragment = project.fragment;
+			QCryptographicHash hash(QCryptographicHash::Sha1);
+			for(size_t i = 0; i < parameters.size(); ++i)
+			{
+				if(parameters[i].define)
+				{
+					vertex.replace(defineLine(parameters[i].name), "\\1 " + literal(values[i]));
+					fragment.replace(defineLine(parameters[i].name), "\\1 " + literal(values[i]));
+				}
+				else hash.addData((parameters[i].name + "=" + literal(values[i]) + "\n").toUtf8());
+			}
+			Source source(
+						GLWidget::assemble(GL_VERTEX_SHADER, vertex.toStdString(), render.usesMultiDraw(), false),
+						GLWidget::assemble(GL_FRAGMENT_SHADER, fragment.toStdString(), render.usesMultiDraw(), false));
+			hash.addData(source.first.c_str(), int(source.first.size()));
+			hash.addData(source.second.c_str(), int(source.second.size()));
+			key = hash.result();
+			return source;
+		};
+
+		std::vector<Source> sources;	// one variant per set of #define values, only those that get rendered
+		std::map<Source, int> variants;
+		auto program = [&](const Source &source)
+		{
+			auto known = variants.find(source);
+			if(known != variants.end()) return known->second;
+			sources.push_back(source);
+			return variants[source] = int(sources.size() - 1);
+		};
+		// a fully cached re-run compiles nothing, and one new point only compiles its own variant and the reference's
+
+		QByteArray referenceKey;
+		Source referenceSource = variant(reference, referenceKey);
+		QCryptographicHash settingsHash(QCryptographicHash::Sha1);
+		settingsHash.addData(referenceKey);
+		settingsHash.addData(QString("%1 %2x%3 %4 frames at").arg(renderer).arg(settings.width).arg(settings.height)
+							 .arg(settings.frames).toUtf8());
+		for(GLfloat t : times) settingsHash.addData(QByteArray::number(t));
+		QByteArray common = settingsHash.result();
+		// a point is only reused when the reference and everything about the measurement match too
+
+		bool work = false;
+		for(SweepPoint &point : points)
+		{
+			QByteArray key;
+			Source source = variant(point.values, key);
+			point.key = QCryptographicHash::hash(common + key, QCryptographicHash::Sha1).toHex();
+			QJsonObject known = cache.value(QString(point.key)).toObject();
+			point.cached = !known.isEmpty();
+			if(point.cached)
+			{
+				point.gpu = known.value("gpu").toDouble();
+				point.rmse = known.value("rmse").toDouble();
+				point.visible = known.value("visible").toDouble();
+			}
+			else point.program = program(source);
+			work = work || !point.cached;
+		}
+
+		if(work)
+		{
+			int referenceProgram = program(referenceSource);
+			std::vector<QString> logs;
+			std::vector<GLProgram> programs = compileAll(render.registry(), sources, logs);
+			if(!programs[referenceProgram])
+			{
+				err << "The reference doesn't compile:\n" << logs[referenceProgram] << "\n";
+				return 2;
+			}
+
+			auto use = [&](int program, const std::vector<double> &values)
+			{
+				render.setProgram(programs[program]);
+				for(size_t i = 0; i < parameters.size(); ++i)
+					if(!parameters[i].define && !render.setUniform(parameters[i].name, values[i])) return false;
+				return true;
+			};
+			if(!use(referenceProgram, reference))
+			{
+				err << "Every parameter has to be a #define or a float, int or bool uniform the shader uses.\n";
+				return 2;
+			}
+			std::vector<QImage> expected;
+			for(GLfloat t : times) expected.push_back(render.render(t));
+
+			size_t done = 0, total = std::count_if(points.begin(), points.end(), [](const SweepPoint &p) { return !p.cached; });
+			for(SweepPoint &point : points)
+			{
+				if(point.cached) continue;
+				err << "\rRendering " << ++done << "/" << total;
+				err.flush();
+				if(!programs[point.program])
+				{
+					point.failed = true;
+					continue;
+				}
+
+				use(point.program, point.values);
+				for(size_t i = 0; i < times.size(); ++i)
+				{
+					DiffResult diff = ImageDiff::compare(expected[i], render.render(times[i]), 8);
+					point.rmse += diff.rmse / times.size();
+					point.visible += diff.visibleFraction() / times.size();
+				}
+				double cpu;
+				point.gpu = render.time(times.front(), settings.frames, cpu);
+
+				QJsonObject result;
+				result["gpu"] = point.gpu;
+				result["rmse"] = point.rmse;
+				result["visible"] = point.visible;
+				cache[QString(point.key)] = result;
+			}
+			err << "\n";
+
+			for(size_t p = 0; p < logs.size(); ++p)	// every variant that didn't compile, once
+			{
+				if(logs[p].isEmpty()) continue;
+				++failed;
+				out << "A variant didn't compile:\n";
+				for(const QString &line : logs[p].trimmed().split('\n', QString::SkipEmptyParts)) out << "        " << line << "\n";
+			}
+		}
+	}	// GL objects go before the context
+	context.doneCurrent();
+
+	if(cacheFile.open(QFile::WriteOnly)) cacheFile.write(QJsonDocument(cache).toJson(QJsonDocument::Compact));
+
+	std::vector<size_t> order;
+	for(size_t i = 0; i < points.size(); ++i) if(!points[i].failed) order.push_back(i);
+	std::sort(order.begin(), order.end(), [&points](size_t a, size_t b)
+	{ return points[a].gpu != points[b].gpu ? points[a].gpu < points[b].gpu : points[a].rmse < points[b].rmse; });
+	std::vector<bool> pareto(points.size(), false);
+	double best = std::numeric_limits<double>::infinity();
+	for(size_t i : order)	// cheapest first, a point is on the frontier when it's better than every cheaper one
+	{
+		if(points[i].rmse >= best) continue;
+		best = points[i].rmse;
+		pareto[i] = true;
+	}
+
+	auto describe = [&](const std::vector<double> &values)
+	{
+		QString text;
+		for(size_t i = 0; i < parameters.size(); ++i) text += parameters[i].name + "=" + literal(values[i]) + " ";
+		return text.trimmed();
+	};
+
+	out << "Reference: " << describe(reference) << ", " << times.size() << " images at " << settings.width << "x"
+		<< settings.height << " on " << renderer << "\n\n";
+	out << QString("combination").leftJustified(40) << QString("GPU ms").rightJustified(10)
+		<< QString("RMSE").rightJustified(10) << QString("visible").rightJustified(10) << "\n";
+	for(size_t i = 0; i < points.size(); ++i)
+	{
+		const SweepPoint &point = points[i];
+		out << describe(point.values).leftJustified(40);
+		if(point.failed) out << QString("doesn't compile").rightJustified(30) << "\n";
+		else out << QString::number(point.gpu, 'f', 3).rightJustified(10) << QString::number(point.rmse, 'f', 3).rightJustified(10)
+				 << (QString::number(100 * point.visible, 'f', 2) + "%").rightJustified(10)
+				 << (pareto[i] ? "  *" : "   ") << (point.cached ? " (cached)" : "") << "\n";
+	}
+	out << "\nPareto frontier (* above), cheapest first:\n";
+	for(size_t i : order)
+		if(pareto[i]) out << "  " << describe(points[i].values) << ": " << QString::number(points[i].gpu, 'f', 3)
+						  << " ms, RMSE " << QString::number(points[i].rmse, 'f', 3) << "\n";
+
+	if(!settings.csv.isEmpty())
+	{
+		QFile csvFile(settings.csv);
+		if(!csvFile.open(QFile::WriteOnly | QFile::Text))
+		{
+			err << "Could not write " << settings.csv << "\n";
+			return 2;
+		}
+		QTextStream csv(&csvFile);
+		for(const SweepParameter &parameter : parameters) csv << parameter.name << ",";
+		csv << "gpu_ms,rmse,visible,pareto\n";
+		for(size_t i = 0; i < points.size(); ++i)
+		{
+			if(points[i].failed) continue;
+			for(double value : points[i].values) csv << literal(value) << ",";
+			csv << points[i].gpu << "," << points[i].rmse << "," << points[i].visible << "," << (pareto[i] ? 1 : 0) << "\n";
+		}
+	}
+	return failed ? 1 : 0;
+}
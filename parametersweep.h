@@ -0,0 +1,51 @@
+#ifndef PARAMETERSWEEP_H
+#define PARAMETERSWEEP_H
+
+#include <vector>
+#include <QString>
+#include <QStringList>
+#include <GL/glew.h>
+
+/** CLARIFICATION:
+ * "Qt_GLSL_IDE --sweep <project.glsl> --param STEPS=16:256:*2 --param octaves=1:8" renders every
+ * combination of the parameters offscreen, measures its GPU time, and compares its images with those
+ * of the reference combination (the largest value of every parameter, or what --reference says).
+ * The report marks the Pareto frontier: the combinations no other one beats on both time and error.
+ *
+ * A parameter is a #define when the project has a "#define NAME" line, whose value is replaced (so every
+ * value compiles its own variant), and a uniform otherwise, set before every draw. Values are given as
+ * a list "1,2,4", a range "1:8" or "0.5:2:0.25", or a geometric range "16:256:*2".
+ *
+ * The variants that get rendered are compiled before any is used, with as many driver threads as it offers
+ * where KHR/ARB_parallel_shader_compile exist. Results are cached in "<project>.sweep.json", keyed by the
+ * sources, values, reference and render settings, so a re-run only compiles and renders combinations that are new.
+ **/
+
+struct SweepParameter
+{
+	QString name;
+	std::vector<double> values;
+	bool define = false;	// decided from the project's sources
+
+	static bool parse(const QString&, SweepParameter&, QString &error);	// NAME=values
+};
+
+struct SweepSettings
+{
+	QString project;
+	std::vector<SweepParameter> parameters;
+	QStringList reference;	// NAME=value, for parameters whose reference isn't their largest value
+	std::vector<GLfloat> times = {0.0f, 1.0f, 5.0f};
+	int width = 640, height = 360;
+	int frames = 60;	// timed frames per combination
+	QString cache;	// "<project>.sweep.json" when empty
+	QString csv;	// optional copy of the results
+};
+
+class ParameterSweep
+{
+public:
+	static int run(const SweepSettings&);
+};
+
+#endif // PARAMETERSWEEP_H
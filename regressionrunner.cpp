@@ -0,0 +1,161 @@
+#include "regressionrunner.h"
+#include <memory>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QTextStream>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include "glslfile.h"
+#include "imagediff.h"
+#include "offscreenrenderer.h"
+
+int RegressionRunner::run(const RegressionSettings &settings)
+{
+	QTextStream out(stdout), err(stderr);
+
+	QStringList paths;
+	QDirIterator files(settings.directory, QStringList() << "*.glsl", QDir::Files, QDirIterator::Subdirectories);
+	while(files.hasNext()) paths.append(files.next());
+	paths.sort();
+	if(paths.isEmpty())
+	{
+		err << "No .glsl files found in " << settings.directory << "\n";
+		return 2;
+	}
+
+	QOffscreenSurface surface;
+	surface.create();
+	QOpenGLContext context;
+	if(!context.create() || !context.makeCurrent(&surface))
+	{
+		err << "Could not create a GL context.\n";
+		return 2;
+	}
+	glewExperimental = GL_TRUE;
+	glewInit();
+	QString renderer = QString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+	QDir directory(settings.directory), references(settings.references), output(settings.output);
+	QFile timingFile(references.filePath("timings.json"));
+	QJsonObject baseline;
+	if(timingFile.open(QFile::ReadOnly)) baseline = QJsonDocument::fromJson(timingFile.readAll()).object();
+	timingFile.close();
+	bool compareTimes = !settings.update && baseline.value("renderer").toString() == renderer;
+	if(!settings.update && !baseline.isEmpty() && !compareTimes)
+		err << "timings.json was recorded on " << baseline.value("renderer").toString() << ", not comparing timings.\n";
+	QJsonObject timings = baseline.value("projects").toObject();
+	bool recordAll = settings.update || baseline.isEmpty(), recorded = false;
+	// the first run records the baseline, later runs only add projects that are new to it
+
+	int failed = 0;
+	{
+		OffscreenRenderer render(settings.width, settings.height);
+		for(const QString &path : paths)
+		{
+			QString name = directory.relativeFilePath(path);
+			QString stem = name.left(name.size() - QString(".glsl").size());
+			QString log;
+			bool passed = true;
+
+			GLSLFile project;
+			QStringList included;
+			QString folder = QFileInfo(path).absolutePath();
+			if(!project.read(path)) log = "Not a GLSL project file.\n";
+			else if(!GLSLFile::expandIncludes(project.vertex, folder, included, log)
+					|| !GLSLFile::expandIncludes(project.fragment, folder, included, log)
+					|| !GLSLFile::expandIncludes(project.compute, folder, included, log)) log += "\n";
+			else if(!render.load(project, folder, log)) log += "\n";
+			if(!log.isEmpty())
+			{
+				out << "FAIL  " << name << "\n";
+				for(const QString &line : log.trimmed().split('\n', QString::SkipEmptyParts)) out << "        " << line << "\n";
+				++failed;
+				continue;
+			}
+
+			for(GLfloat t : settings.times)
+			{
+				QString image = stem + "@" + QString::number(t) + ".png";
+				QImage actual = render.render(t);
+				if(settings.update)
+				{
+					QDir().mkpath(QFileInfo(references.filePath(image)).absolutePath());
+					if(!actual.save(references.filePath(image))) log += "Could not write " + references.filePath(image) + "\n";
+					continue;
+				}
+
+				QImage reference(references.filePath(image));
+				if(reference.isNull())
+				{
+					log += "t=" + QString::number(t) + ": no reference image, record one with --update\n";
+					passed = false;
+					continue;
+				}
+
+				DiffResult diff = ImageDiff::compare(reference, actual, settings.threshold);
+				bool same = diff.visibleFraction() <= settings.tolerance;
+				log += QString("t=%1: max %2, rmse %3, %4% visibly different%5\n").arg(t).arg(diff.maxError)
+						.arg(diff.rmse, 0, 'f', 2).arg(100.0 * diff.visibleFraction(), 0, 'f', 3)
+						.arg(same ? "" : " - FAILED");
+				if(same) continue;
+				passed = false;
+
+				QString actualPath = output.filePath(stem + "@" + QString::number(t) + ".actual.png");
+				QDir().mkpath(QFileInfo(actualPath).absolutePath());
+				actual.save(actualPath);
+				ImageDiff::heatmap(reference, actual, settings.threshold)
+						.save(output.filePath(stem + "@" + QString::number(t) + ".diff.png"));
+			}
+
+			double cpu = 0;
+			double gpu = render.time(settings.times.empty() ? 0.0f : settings.times.front(), settings.frames, cpu);
+			QJsonObject previous = timings.value(name).toObject();
+			if(compareTimes && previous.contains("gpu"))
+			{
+				double expected = previous.value("gpu").toDouble();
+				bool slower = expected > 0 && gpu > expected * (1 + settings.slowdown);
+				log += QString("GPU %1 ms, baseline %2 ms (%3%4%)%5\n").arg(gpu, 0, 'f', 3).arg(expected, 0, 'f', 3)
+						.arg(gpu >= expected ? "+" : "").arg(expected > 0 ? 100.0 * (gpu - expected) / expected : 0, 0, 'f', 1)
+						.arg(slower ? " - TOO SLOW" : "");
+				passed = passed && !slower;
+			}
+			else log += QString("GPU %1 ms, CPU %2 ms\n").arg(gpu, 0, 'f', 3).arg(cpu, 0, 'f', 3);
+			if(render.computeMilliseconds() >= 0)
+				log += QString("compute dispatch %1 ms\n").arg(render.computeMilliseconds(), 0, 'f', 3);
+			if(recordAll || (compareTimes && !previous.contains("gpu")))
+			{
+				QJsonObject timing;
+				timing["gpu"] = gpu;
+				timing["cpu"] = cpu;
+				timings[name] = timing;
+				recorded = true;
+			}
+
+			if(!passed) ++failed;
+			out << (passed ? "ok    " : "FAIL  ") << name << "\n";
+			for(const QString &line : log.trimmed().split('\n', QString::SkipEmptyParts)) out << "        " << line << "\n";
+		}
+	}	// GL objects go before the context
+
+	if(recorded)
+	{
+		QJsonObject document;
+		document["renderer"] = renderer;
+		document["width"] = settings.width;
+		document["height"] = settings.height;
+		document["projects"] = timings;
+		QDir().mkpath(references.absolutePath());
+		if(timingFile.open(QFile::WriteOnly)) timingFile.write(QJsonDocument(document).toJson());
+	}
+
+	context.doneCurrent();
+	out << paths.size() << " projects, " << failed << " failed, " << settings.times.size() << " images each at "
+		<< settings.width << "x" << settings.height << " (" << renderer << ", "
+		<< (ImageDiff::vectorized() ? "SSE2" : "scalar") << " diff)\n";
+	return failed ? 1 : 0;
+}
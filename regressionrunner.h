@@ -0,0 +1,43 @@
+#ifndef REGRESSIONRUNNER_H
+#define REGRESSIONRUNNER_H
+
+#include <vector>
+#include <QString>
+#include <GL/glew.h>
+
+/** CLARIFICATION:
+ * "Qt_GLSL_IDE --regress <folder>" renders every .glsl project below the folder offscreen, on the default
+ * square, at a few fixed time values, and compares the images with the ones stored in the references folder.
+ * The built-ins are pinned (see offscreenrenderer.h), and a compute stage starts from its initial buffers
+ * for every project.
+ *
+ * An image fails when more than "tolerance" of its pixels are visibly different (see imagediff.h); its
+ * render and a heatmap of the differences are then written to the output folder. Every project is also
+ * timed, and the median GPU time is checked against timings.json in the references folder, as long as
+ * that was recorded on the same renderer. "--update" writes new references and timings instead.
+ *
+ * "--software" asks Mesa for llvmpipe, so CI machines without a GPU get the same images every run
+ * (run it under xvfb-run, or with "-platform offscreen" where the Qt build supports GL there).
+ **/
+
+struct RegressionSettings
+{
+	QString directory;	// projects, searched recursively
+	QString references;	// reference images and timings.json
+	QString output;	// renders and heatmaps of failed images
+	std::vector<GLfloat> times = {0.0f, 1.0f, 5.0f};
+	int width = 640, height = 360;
+	int threshold = 8;	// weighted difference (0-255) a pixel may have and still count as the same
+	double tolerance = 0.001;	// fraction of visibly different pixels an image may have
+	int frames = 60;	// timed frames per project
+	double slowdown = 0.25;	// allowed increase of the median GPU time over the baseline
+	bool update = false;
+};
+
+class RegressionRunner
+{
+public:
+	static int run(const RegressionSettings&);
+};
+
+#endif // REGRESSIONRUNNER_H
@@ -0,0 +1,91 @@
+#include "renderthread.h"
+
+RenderThread::RenderThread(QWindow *target, QObject *parent) : QThread(parent), target(target) {}
+
+void RenderThread::begin()
+{
+	if(offscreen) return;	// once, the context lives as long as the thread
+
+	target->create();	// the platform window has to exist before another thread can draw into it
+	offscreen = new QOffscreenSurface();
+	offscreen->setFormat(target->requestedFormat());
+	offscreen->create();
+	// surfaces can only be created on the GUI thread
+
+	context = new QOpenGLContext();
+	context->setFormat(target->requestedFormat());
+	if(!context->create())
+	{
+		qWarning("Could not create the GL context.");
+		return;
+	}
+	if(!QOpenGLContext::supportsThreadedOpenGL())
+		qWarning("The platform doesn't report support for rendering outside of the GUI thread.");
+	context->moveToThread(this);
+	start();
+}
+
+void RenderThread::post(std::function<void()> command)
+{
+	while(!commands.push(command))	// only when the thread is far behind, or hasn't been started yet
+	{
+		begin();
+		if(!isRunning()) return;	// without a context the command could never run
+		wake.release();
+		QThread::yieldCurrentThread();
+	}
+	wake.release();
+}
+
+void RenderThread::setExposed(bool visible)
+{
+	exposed.store(visible);
+	wake.release();
+}
+
+void RenderThread::run()
+{
+	context->makeCurrent(offscreen);
+	initialize();
+
+	std::function<void()> command;
+	while(!stopping.load())
+	{
+		bool drawing = exposed.load();
+		QSurface *surface = drawing ? static_cast<QSurface*>(target) : offscreen;
+		if(context->surface() != surface) context->makeCurrent(surface);
+
+		while(commands.pop(command)) command();	// everything the GUI thread asked for since the last frame
+
+		if(!drawing)
+		{
+			wake.tryAcquire(1, 100);	// sleeps until a command arrives, the window shows up or finish()
+			wake.tryAcquire(wake.available());
+			continue;
+		}
+		render();
+		context->swapBuffers(target);	// paced by vsync, like the GUI thread's timer used to be
+		wake.tryAcquire(wake.available());	// the commands behind these run at the top of the loop anyway
+	}
+
+	context->makeCurrent(offscreen);	// the window may already be on its way out
+	cleanup();
+	context->doneCurrent();
+	delete context;	// on the thread it belongs to
+	context = nullptr;
+}
+
+void RenderThread::finish()
+{
+	if(!isRunning()) return;
+	stopping.store(true);
+	wake.release();
+	wait();
+}
+
+RenderThread::~RenderThread()
+{
+	finish();
+	delete context;	// only left when it couldn't be created
+	delete offscreen;
+}
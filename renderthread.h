@@ -0,0 +1,118 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <QThread>
+#include <QSemaphore>
+#include <QWindow>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <GL/glew.h>
+
+/** CLARIFICATION:
+ * The preview renders on its own thread, so typing, highlighting and dialogs on the GUI thread never hold up
+ * a frame, and a slow frame never holds up the editor. The thread owns the GL context and draws into a QWindow;
+ * nothing else touches GL. The GUI thread talks to it in two ways, neither of which ever takes a lock:
+ *
+ * - commands (compile this, upload that) go through a CommandQueue and run in order before the next frame,
+ * - values that only matter in their newest version (window size, mouse, the statistics of the last frame)
+ *   go through a LatestValue, which the writer can overwrite and the reader can re-read at any pace.
+ *
+ * While the window isn't exposed the context is current on an offscreen surface instead, so commands still
+ * run (textures and models load with the preview closed) but no frames are drawn.
+ **/
+
+class CommandQueue	// one thread pushes, one other thread pops
+{
+public:
+	bool push(std::function<void()> &command)	// false when full, the command is only moved from otherwise
+	{
+		size_t position = tail.load(std::memory_order_relaxed);
+		if(position - head.load(std::memory_order_acquire) == capacity) return false;
+		ring[position % capacity] = std::move(command);
+		tail.store(position + 1, std::memory_order_release);	// the command is written before it's visible
+		return true;
+	}
+
+	bool pop(std::function<void()> &command)
+	{
+		size_t position = head.load(std::memory_order_relaxed);
+		if(position == tail.load(std::memory_order_acquire)) return false;
+		command = std::move(ring[position % capacity]);
+		ring[position % capacity] = nullptr;	// whatever it captured is freed now, not when the slot is reused
+		head.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static const size_t capacity = 1024;
+	std::function<void()> ring[capacity];
+	alignas(64) std::atomic<size_t> head{0};	// own cache lines, so the two threads don't bounce one between them
+	alignas(64) std::atomic<size_t> tail{0};
+};
+
+template<typename T>
+class LatestValue	// one thread publishes, one other thread reads the newest
+{
+public:
+	void publish(const T &value)
+	{
+		slots[writing] = value;
+		writing = middle.exchange(writing | fresh, std::memory_order_acq_rel) & 3;
+	}
+
+	const T &latest()	// stays valid, and the same, until the next call
+	{
+		if(middle.load(std::memory_order_relaxed) & fresh)
+			reading = middle.exchange(reading, std::memory_order_acq_rel) & 3;
+		return slots[reading];
+	}
+
+	/** CLARIFICATION:
+	 * Double buffering between two threads that don't wait for each other needs a third slot: the writer fills
+	 * one, the reader reads another, and the one in the middle is swapped with either side, together with a bit
+	 * that says whether it holds something the reader hasn't seen yet.
+	 **/
+
+private:
+	static const int fresh = 4;
+	T slots[3];
+	int writing = 0, reading = 2;	// each only used by its own thread
+	std::atomic<int> middle{1};
+};
+
+class RenderThread : public QThread
+{
+	Q_OBJECT
+public:
+	explicit RenderThread(QWindow *target, QObject *parent = nullptr);
+	~RenderThread();
+
+	// set before the thread starts, they run on it with the context current
+	std::function<void()> initialize;
+	std::function<void()> render;
+	std::function<void()> cleanup;
+
+	// the functions below are for the GUI thread
+	void begin();	// creates the context and starts the thread, if that hasn't happened yet
+	void post(std::function<void()>);	// runs before the next frame, or once the thread runs
+	void setExposed(bool);
+	void finish();	// runs cleanup and waits for the thread to end
+
+	GLuint framebuffer() const { return context->defaultFramebufferObject(); }	// for the render thread
+
+protected:
+	void run();
+
+private:
+	QWindow *target;
+	QOffscreenSurface *offscreen = nullptr;
+	QOpenGLContext *context = nullptr;
+	CommandQueue commands;
+	QSemaphore wake;
+	std::atomic<bool> exposed{false}, stopping{false};
+};
+
+#endif // RENDERTHREAD_H
@@ -0,0 +1,196 @@
+#include "shaderbench.h"
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <cstdlib>
+#include <QElapsedTimer>
+
+BenchResult ShaderBench::run(GLResources &resources, const std::function<void(GLuint, GLfloat, int, int)> &draw,
+							 GLuint programA, GLuint programB, const BenchSettings &settings)
+{
+	/** CLARIFICATION:
+	 * Both shaders are rendered interleaved, and the order within every pair alternates (AB, BA, AB...),
+	 * so that clock ramping, thermal throttling and other slow drift affect both of them equally.
+	 * Every frame is finished before the next one starts - that keeps the two shaders from overlapping
+	 * on the GPU, and makes the CPU time the full submit-to-completion time of the frame.
+	 **/
+
+	BenchResult result;
+	result.settings = settings;
+
+	GLFramebuffer framebuffer(resources, "comparison framebuffer");
+	GLRenderbuffer colorBuffer(resources, "comparison color"), depthBuffer(resources, "comparison depth");
+	GLQuery query(resources, "comparison timer");
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, settings.width, settings.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, settings.width, settings.height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	// fixed-size offscreen target, so the window size doesn't affect the result
+
+	auto measure = [&](GLuint program, std::vector<double> &gpu, std::vector<double> &cpu, bool keep)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		draw(program, settings.time, settings.width, settings.height);
+		glEndQuery(GL_TIME_ELAPSED);
+		glFinish();
+		double cpuTime = timer.nsecsElapsed()/1e6;
+
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuTime);
+		if(!keep) return;
+		gpu.push_back(gpuTime/1e6);
+		cpu.push_back(cpuTime);
+	};
+
+	for(int i = -settings.warmup; i < settings.frames; ++i)
+	{
+		bool keep = i >= 0;
+		if(i%2 == 0)
+		{
+			measure(programA, result.gpuA, result.cpuA, keep);
+			measure(programB, result.gpuB, result.cpuB, keep);
+		}
+		else
+		{
+			measure(programB, result.gpuB, result.cpuB, keep);
+			measure(programA, result.gpuA, result.cpuA, keep);
+		}
+	}
+
+	/** compare the output of both shaders **/
+
+	size_t pixelCount = size_t(settings.width)*settings.height;
+	std::vector<unsigned char> pixelsA(pixelCount*4), pixelsB(pixelCount*4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	draw(programA, settings.time, settings.width, settings.height);
+	glReadPixels(0, 0, settings.width, settings.height, GL_RGBA, GL_UNSIGNED_BYTE, pixelsA.data());
+	draw(programB, settings.time, settings.width, settings.height);
+	glReadPixels(0, 0, settings.width, settings.height, GL_RGBA, GL_UNSIGNED_BYTE, pixelsB.data());
+
+	size_t differing = 0;
+	for(size_t p = 0; p < pixelCount; ++p)
+	{
+		int pixelError = 0;
+		for(int c = 0; c < 4; ++c)
+			pixelError = std::max(pixelError, std::abs(pixelsA[p*4 + c] - pixelsB[p*4 + c]));
+		if(pixelError > 0) ++differing;
+		result.maxPixelError = std::max(result.maxPixelError, pixelError);
+	}
+	result.differingPixels = pixelCount ? double(differing)/pixelCount : 0;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	result.gpuSummaryA = summarize(result.gpuA);
+	result.gpuSummaryB = summarize(result.gpuB);
+	result.cpuSummaryA = summarize(result.cpuA);
+	result.cpuSummaryB = summarize(result.cpuB);
+	result.gpuDifference = difference(result.gpuA, result.gpuB);
+	result.cpuDifference = difference(result.cpuA, result.cpuB);
+	return result;
+}
+
+double ShaderBench::percentile(const std::vector<double> &sorted, double p)
+{
+	if(sorted.empty()) return 0;
+	double position = p*(sorted.size() - 1);
+	size_t below = size_t(position);
+	size_t above = std::min(below + 1, sorted.size() - 1);
+	return sorted[below] + (sorted[above] - sorted[below])*(position - below);
+	// linear interpolation between the two closest ranks
+}
+
+TimingSummary ShaderBench::summarize(std::vector<double> values)
+{
+	TimingSummary summary;
+	if(values.empty()) return summary;
+	std::sort(values.begin(), values.end());
+	summary.median = percentile(values, 0.5);
+	summary.p95 = percentile(values, 0.95);
+	summary.p99 = percentile(values, 0.99);
+	summary.mean = std::accumulate(values.begin(), values.end(), 0.0)/values.size();
+	return summary;
+}
+
+Difference ShaderBench::difference(const std::vector<double> &a, const std::vector<double> &b)
+{
+	/** CLARIFICATION:
+	 * Frames were measured in pairs, so the per-pair differences B - A are used directly (that cancels
+	 * out drift shared by both shaders). The confidence interval of their median is estimated with a
+	 * percentile bootstrap: resample the differences with replacement, take the median of every
+	 * resample, and use the 2.5th and 97.5th percentile of those medians. Frame times are skewed
+	 * and have outliers, which is why this is used instead of a t-interval on the means.
+	 **/
+
+	Difference result;
+	size_t n = std::min(a.size(), b.size());
+	if(n == 0) return result;
+
+	std::vector<double> differences(n);
+	for(size_t i = 0; i < n; ++i) differences[i] = b[i] - a[i];
+
+	std::vector<double> sorted = differences;
+	std::sort(sorted.begin(), sorted.end());
+	result.median = percentile(sorted, 0.5);
+
+	const int resamples = 2000;
+	std::mt19937 generator(1);	// fixed seed, so the same measurements always give the same interval
+	std::uniform_int_distribution<size_t> pick(0, n - 1);
+	std::vector<double> medians(resamples), resample(n);
+	for(int r = 0; r < resamples; ++r)
+	{
+		for(size_t i = 0; i < n; ++i) resample[i] = differences[pick(generator)];
+		std::nth_element(resample.begin(), resample.begin() + n/2, resample.end());
+		medians[r] = resample[n/2];
+	}
+	std::sort(medians.begin(), medians.end());
+	result.low = percentile(medians, 0.025);
+	result.high = percentile(medians, 0.975);
+	return result;
+}
+
+QString BenchResult::report() const
+{
+	auto number = [](double value) { return QString::number(value, 'f', 3); };
+	auto row = [&](const QString &name, double a, double b)
+	{
+		return name.leftJustified(14) + number(a).rightJustified(12) + number(b).rightJustified(12) + "\n";
+	};
+	auto verdict = [&](const QString &name, const Difference &d, double baseline)
+	{
+		QString text = name + " difference (B - A): " + (d.median >= 0 ? "+" : "") + number(d.median) + " ms";
+		if(baseline > 0) text += " (" + QString::number(100.0*d.median/baseline, 'f', 1) + "%)";
+		text += ", 95% CI [" + number(d.low) + ", " + number(d.high) + "] ms - ";
+		if(d.low > 0) text += "B is slower\n";
+		else if(d.high < 0) text += "B is faster\n";
+		else text += "no significant difference\n";
+		return text;
+	};
+
+	QString text = "A/B comparison: " + QString::number(settings.frames) + " frames each at "
+			+ QString::number(settings.width) + "x" + QString::number(settings.height)
+			+ ", time " + QString::number(settings.time) + "\n";
+	text += "A: " + settings.nameA + "\nB: " + settings.nameB + "\n\n";
+	text += QString("(ms)").leftJustified(14) + QString("A").rightJustified(12) + QString("B").rightJustified(12) + "\n";
+	text += row("GPU median", gpuSummaryA.median, gpuSummaryB.median);
+	text += row("GPU p95", gpuSummaryA.p95, gpuSummaryB.p95);
+	text += row("GPU p99", gpuSummaryA.p99, gpuSummaryB.p99);
+	text += row("GPU mean", gpuSummaryA.mean, gpuSummaryB.mean);
+	text += row("CPU median", cpuSummaryA.median, cpuSummaryB.median);
+	text += row("CPU p95", cpuSummaryA.p95, cpuSummaryB.p95);
+	text += row("CPU p99", cpuSummaryA.p99, cpuSummaryB.p99);
+	text += row("CPU mean", cpuSummaryA.mean, cpuSummaryB.mean);
+	text += "\n";
+	text += verdict("GPU", gpuDifference, gpuSummaryA.median);
+	text += verdict("CPU", cpuDifference, cpuSummaryA.median);
+	text += "\n";
+	if(maxPixelError == 0) text += "Output: identical\n";
+	else text += "Output: differs in " + QString::number(100.0*differingPixels, 'f', 2)
+			+ "% of pixels, largest channel error " + QString::number(maxPixelError) + "/255\n";
+	return text;
+}
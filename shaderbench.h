@@ -0,0 +1,52 @@
+#ifndef SHADERBENCH_H
+#define SHADERBENCH_H
+
+#include <vector>
+#include <functional>
+#include <QString>
+#include <GL/glew.h>
+#include "glresource.h"
+
+struct BenchSettings
+{
+	int frames = 200;	// measured frames per shader
+	int warmup = 10;	// frames rendered before measuring, to settle clocks and caches
+	int width = 1920, height = 1080;
+	GLfloat time = 0.0f;	// every frame is rendered at the same time value
+	QString nameA = "A", nameB = "B";
+};
+
+struct TimingSummary
+{
+	double median = 0, p95 = 0, p99 = 0, mean = 0;
+};
+
+struct Difference
+{
+	double median = 0, low = 0, high = 0;	// median of B - A and its 95% confidence interval
+};
+
+struct BenchResult
+{
+	BenchSettings settings;
+	std::vector<double> gpuA, gpuB, cpuA, cpuB;	// milliseconds per frame
+	TimingSummary gpuSummaryA, gpuSummaryB, cpuSummaryA, cpuSummaryB;
+	Difference gpuDifference, cpuDifference;
+	int maxPixelError = 0;	// largest difference of a single channel between the outputs
+	double differingPixels = 0;	// fraction of pixels that aren't identical
+
+	QString report() const;
+};
+
+class ShaderBench
+{
+public:
+	static BenchResult run(GLResources&, const std::function<void(GLuint, GLfloat, int, int)> &draw,
+						   GLuint programA, GLuint programB, const BenchSettings&);
+
+	static double percentile(const std::vector<double>&, double);
+	static TimingSummary summarize(std::vector<double>);
+	static Difference difference(const std::vector<double>&, const std::vector<double>&);
+};
+
+#endif // SHADERBENCH_H
@@ -0,0 +1,55 @@
+#include "shaderbuild.h"
+
+void ShaderBuild::compile(GLuint shader, const std::string &source)
+{
+	const char *text = source.c_str();
+	glShaderSource(shader, 1, &text, nullptr);
+	glCompileShader(shader);
+}
+
+void ShaderBuild::link(GLuint program, const std::vector<GLuint> &shaders)
+{
+	for(GLuint shader : shaders) glAttachShader(program, shader);
+	glLinkProgram(program);
+	for(GLuint shader : shaders) glDetachShader(program, shader);
+	// the program keeps what it linked, the shaders can go whenever their owner lets them
+}
+
+bool ShaderBuild::compiled(GLuint shader, const char *stage, QString &log)
+{
+	GLint status;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);	// waits for the compiler
+	if(status == GL_TRUE) return true;
+
+	GLint length = 0;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+	std::vector<GLchar> text(length + 1);
+	glGetShaderInfoLog(shader, length, &length, text.data());
+	log += QString("In ") + stage + " shader:\n" + text.data();
+	return false;
+}
+
+bool ShaderBuild::linked(GLuint program, QString &log)
+{
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if(status == GL_TRUE) return true;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+	std::vector<GLchar> text(length + 1);
+	glGetProgramInfoLog(program, length, &length, text.data());
+	log += QString("While linking:\n") + text.data();
+	return false;
+}
+
+const char *ShaderBuild::stageName(GLenum stage)
+{
+	switch(stage)
+	{
+	case GL_VERTEX_SHADER: return "vertex";
+	case GL_FRAGMENT_SHADER: return "fragment";
+	case GL_COMPUTE_SHADER: return "compute";
+	default: return "unknown";
+	}
+}
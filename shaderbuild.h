@@ -0,0 +1,28 @@
+#ifndef SHADERBUILD_H
+#define SHADERBUILD_H
+
+#include <string>
+#include <vector>
+#include <QString>
+#include <GL/glew.h>
+
+/** CLARIFICATION:
+ * Compiling and linking, split into handing the work to the driver and asking for the result, so callers can
+ * issue many before waiting on any (drivers that compile in the background overlap them). When something
+ * failed, the status functions add the driver's log to the caller's, headed with the stage it came from.
+ * They take plain GL names, so they work on GLHandle objects and on the raw objects of worker threads alike.
+ **/
+
+class ShaderBuild
+{
+public:
+	// the functions below need the GL context to be current
+	static void compile(GLuint shader, const std::string &source);
+	static void link(GLuint program, const std::vector<GLuint> &shaders);	// attaches, links and detaches again
+	static bool compiled(GLuint shader, const char *stage, QString &log);
+	static bool linked(GLuint program, QString &log);
+
+	static const char *stageName(GLenum);
+};
+
+#endif // SHADERBUILD_H
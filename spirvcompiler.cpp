@@ -0,0 +1,145 @@
+#include "spirvcompiler.h"
+
+#ifdef HAVE_SPIRV
+#include <mutex>
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/Public/ResourceLimits.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+#include <spirv-tools/optimizer.hpp>
+#endif
+
+bool SpirvCompiler::available()
+{
+#ifdef HAVE_SPIRV
+	return true;
+#else
+	return false;
+#endif
+}
+
+const char *SpirvCompiler::presetName(Preset preset)
+{
+	static const char *names[PresetCount] = { "unoptimized", "performance", "size" };
+	return names[preset];
+}
+
+bool SpirvCompiler::compile(const std::string &vertex, const std::string &fragment, SpirvProgram &program,
+							QString &log)
+{
+#ifdef HAVE_SPIRV
+	static std::once_flag initialized;
+	std::call_once(initialized, []() { glslang::InitializeProcess(); });
+
+	glslang::TShader vertexShader(EShLangVertex), fragmentShader(EShLangFragment);
+	glslang::TShader *shaders[2] = { &vertexShader, &fragmentShader };
+	const char *sources[2] = { vertex.c_str(), fragment.c_str() };
+	const char *stages[2] = { "vertex", "fragment" };
+	EShMessages messages = EShMessages(EShMsgSpvRules | EShMsgDefault);
+
+	bool parsed = true;
+	for(int i = 0; i < 2; ++i)
+	{
+		glslang::TShader &shader = *shaders[i];
+		shader.setStrings(&sources[i], 1);
+		shader.setEnvInput(glslang::EShSourceGlsl, i == 0 ? EShLangVertex : EShLangFragment,
+						   glslang::EShClientOpenGL, 100);	// the client's dialect version, which is 100 for GL
+		shader.setEnvClient(glslang::EShClientOpenGL, glslang::EShTargetOpenGL_450);
+		shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_0);
+		shader.setAutoMapLocations(true);
+		shader.setAutoMapBindings(true);
+		// GL only accepts SPIR-V where every interface variable has a location and every resource a binding
+
+		if(!shader.parse(GetDefaultResources(), 450, ECoreProfile, false, false, messages))
+		{
+			log += QString("In ") + stages[i] + " shader:\n" + shader.getInfoLog();
+			parsed = false;
+		}
+	}
+	if(!parsed) return false;
+
+	glslang::TProgram linked;
+	linked.addShader(&vertexShader);
+	linked.addShader(&fragmentShader);
+	if(!linked.link(messages) || !linked.mapIO())
+	{
+		log += QString("While linking:\n") + linked.getInfoLog();
+		return false;
+	}
+
+	program.vertex.clear();
+	program.fragment.clear();
+	glslang::GlslangToSpv(*linked.getIntermediate(EShLangVertex), program.vertex);
+	glslang::GlslangToSpv(*linked.getIntermediate(EShLangFragment), program.fragment);
+	return true;
+#else
+	Q_UNUSED(vertex); Q_UNUSED(fragment); Q_UNUSED(program);
+	log += "This build has no SPIR-V support, rebuild with \"qmake CONFIG+=spirv\".\n";
+	return false;
+#endif
+}
+
+bool SpirvCompiler::optimize(const std::vector<uint32_t> &input, Preset preset, std::vector<uint32_t> &output,
+							 QString &log)
+{
+	if(preset == Unoptimized)
+	{
+		output = input;
+		return true;
+	}
+#ifdef HAVE_SPIRV
+	spvtools::Optimizer optimizer(SPV_ENV_OPENGL_4_5);
+	optimizer.SetMessageConsumer([&log](spv_message_level_t level, const char*, const spv_position_t&,
+								 const char *message)
+	{
+		if(level <= SPV_MSG_ERROR) log += QString("spirv-opt: ") + message + "\n";
+	});
+	if(preset == Performance) optimizer.RegisterPerformancePasses();
+	else optimizer.RegisterSizePasses();
+	// the same pass lists "spirv-opt -O" and "spirv-opt -Os" run
+	return optimizer.Run(input.data(), input.size(), &output);
+#else
+	Q_UNUSED(output);
+	log += "This build has no SPIR-V support.\n";
+	return false;
+#endif
+}
+
+InstructionCount SpirvCompiler::count(const std::vector<uint32_t> &module)
+{
+	static const uint32_t OpFunction = 54, OpFunctionEnd = 56;
+
+	InstructionCount counted;
+	bool inFunction = false;
+	for(size_t i = 5; i < module.size();)	// the header is 5 words
+	{
+		uint32_t words = module[i] >> 16, opcode = module[i] & 0xFFFF;
+		if(words == 0) break;	// malformed, don't loop forever
+		++counted.total;
+		if(opcode == OpFunction) inFunction = true;
+		else if(opcode == OpFunctionEnd) inFunction = false;
+		else if(inFunction) ++counted.code;
+		i += words;
+	}
+	return counted;
+}
+
+QString SpirvCompiler::report(const SpirvProgram &program, Preset selected)
+{
+	QString text = "SPIR-V instructions (in functions / total):\n";
+	const std::vector<uint32_t> *stages[2] = { &program.vertex, &program.fragment };
+	const char *names[2] = { "vertex", "fragment" };
+	for(int stage = 0; stage < 2; ++stage)
+	{
+		text += QString("  %1 shader\n").arg(names[stage]);
+		for(int preset = 0; preset < PresetCount; ++preset)
+		{
+			std::vector<uint32_t> optimized;
+			QString ignored;
+			if(!optimize(*stages[stage], Preset(preset), optimized, ignored)) continue;
+			InstructionCount counted = count(optimized);
+			text += QString("    %1%2 %3 / %4\n").arg(preset == selected ? "* " : "  ")
+					.arg(presetName(Preset(preset)), -12).arg(counted.code, 6).arg(counted.total, 6);
+		}
+	}
+	return text + "  (* is the variant that is running)\n";
+}
@@ -0,0 +1,46 @@
+#include "startuptrace.h"
+#include <QTextStream>
+
+bool StartupTrace::enabled = false;
+bool StartupTrace::finished = false;
+QElapsedTimer StartupTrace::clock;
+std::vector<std::pair<QString, qint64>> StartupTrace::phases;
+
+void StartupTrace::start(bool enable)
+{
+	enabled = enable;
+	clock.start();
+}
+
+void StartupTrace::mark(const QString &phase)
+{
+	if(!enabled) return;
+	qint64 now = clock.nsecsElapsed();
+	if(!finished)
+	{
+		phases.emplace_back(phase, now);
+		return;
+	}
+	QTextStream(stderr) << "startup: " << phase << " at " << QString::number(now / 1e6, 'f', 1) << " ms\n";
+}
+
+void StartupTrace::finish()
+{
+	if(!enabled || finished) return;
+	finished = true;
+
+	QTextStream err(stderr);
+	err << "startup: " << QString("phase").leftJustified(40) << QString("took").rightJustified(10)
+		<< QString("at").rightJustified(10) << "\n";
+	qint64 previous = 0;
+	for(const auto &phase : phases)
+	{
+		err << "startup: " << phase.first.leftJustified(40)
+			<< QString::number((phase.second - previous) / 1e6, 'f', 1).rightJustified(10)
+			<< QString::number(phase.second / 1e6, 'f', 1).rightJustified(10) << "\n";
+		previous = phase.second;
+	}
+	double total = previous / 1e6;
+	err << "startup: usable after " << QString::number(total, 'f', 1) << " ms"
+		<< (total > 200 ? " (over the 200 ms target)" : "") << "\n";
+}
@@ -0,0 +1,29 @@
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <vector>
+#include <utility>
+#include <QString>
+#include <QElapsedTimer>
+
+/** CLARIFICATION:
+ * "Qt_GLSL_IDE --startup-trace" prints how long each phase of startup took, from the start of main()
+ * until the main window has been shown and the event loop has gone through its first pass, which is when
+ * the editor reacts to input. Phases that happen later, like creating the GL context when the preview
+ * is first shown, are printed as they happen. Without the flag marks cost next to nothing.
+ **/
+
+class StartupTrace
+{
+public:
+	static void start(bool enabled);
+	static void mark(const QString &phase);
+	static void finish();	// prints the phases so far, later marks are printed right away
+
+private:
+	static bool enabled, finished;
+	static QElapsedTimer clock;
+	static std::vector<std::pair<QString, qint64>> phases;	// name and nanoseconds since start
+};
+
+#endif // STARTUPTRACE_H
@@ -0,0 +1,79 @@
+#include "statsview.h"
+#include <QFileDialog>
+
+StatsView::StatsView(GLWidget *glWidget, QWidget *parent) : QWidget(parent), glWidget(glWidget)
+{
+	setGeometry(0, 0, 480, 520);
+	setWindowTitle("GL statistics");
+
+	QVBoxLayout *layout = new QVBoxLayout(this);
+
+	text = new QPlainTextEdit();
+	text->setReadOnly(true);
+	text->setFont(QFont("Liberation Mono", 10));
+	layout->addWidget(text);
+
+	traceButton = new QPushButton("Record call trace...");
+	connect(traceButton, SIGNAL(clicked()), this, SLOT(toggleTrace()));
+	layout->addWidget(traceButton);
+
+	timer = new QTimer(this);
+	connect(timer, SIGNAL(timeout()), this, SLOT(refresh()));
+	timer->start(500);	// twice a second is plenty to read, and costs nothing while rendering
+}
+
+void StatsView::refresh()
+{
+	if(isHidden()) return;
+
+	const GLWidget::FrameReport &frame = glWidget->frameReport();	// the newest the render thread published
+	const GLState::FrameStats &stats = frame.stats;
+	QString report = "Frame " + QString::number(frame.frame) + "\n\n";
+	report += QString("Call").leftJustified(28) + QString("made").rightJustified(8)
+			+ QString("issued").rightJustified(8) + "\n";
+	for(int call = 0; call < GLState::CallCount; ++call)
+	{
+		if(stats.requested[call] == 0) continue;
+		report += QString(GLState::callName(GLState::Call(call))).leftJustified(28)
+				+ QString::number(stats.requested[call]).rightJustified(8)
+				+ QString::number(stats.issued[call]).rightJustified(8) + "\n";
+	}
+	report += QString("Total").leftJustified(28)
+			+ QString::number(stats.totalRequested()).rightJustified(8)
+			+ QString::number(stats.totalIssued()).rightJustified(8) + "\n\n";
+	report += "Redundant calls filtered: " + QString::number(stats.totalRequested() - stats.totalIssued()) + "\n";
+	report += "State changes: " + QString::number(stats.stateChanges) + "\n";
+	report += "Bytes uploaded: " + QString::number(stats.bytesUploaded) + "\n";
+	if(frame.computeMilliseconds >= 0)
+		report += "Compute dispatch GPU time: " + QString::number(frame.computeMilliseconds, 'f', 3) + " ms\n";
+	report += "\n";
+
+	report += QString("Live objects").leftJustified(28) + QString("count").rightJustified(8)
+			+ QString("KB").rightJustified(12) + "\n";
+	for(int kind = 0; kind < GLResources::KindCount; ++kind)
+	{
+		if(frame.liveCount[kind] == 0) continue;
+		report += QString(GLResources::kindName(GLResources::Kind(kind))).leftJustified(28)
+				+ QString::number(frame.liveCount[kind]).rightJustified(8)
+				+ QString::number(frame.liveBytes[kind]/1024.0, 'f', 1).rightJustified(12) + "\n";
+	}
+	report += "GPU memory in use: " + QString::number(frame.totalBytes/1048576.0, 'f', 2) + " MB\n";
+	text->setPlainText(report);
+	traceButton->setText(frame.tracing ? "Stop recording" : "Record call trace...");	// also when the file couldn't be written
+}
+
+void StatsView::toggleTrace()
+{
+	if(glWidget->isTracing())
+	{
+		glWidget->stopTrace();
+		traceButton->setText("Record call trace...");
+		return;
+	}
+
+	QString path = QFileDialog::getSaveFileName(this, "Save call trace", "", "Text files (*.txt);;All files (*.*)");
+	if(path == "") return;
+	glWidget->startTrace(path);
+	traceButton->setText("Stop recording");
+	// every call of every frame is written until recording is stopped
+}
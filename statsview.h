@@ -0,0 +1,28 @@
+#ifndef STATSVIEW_H
+#define STATSVIEW_H
+
+#include <QWidget>
+#include <QLayout>
+#include <QTimer>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include "glwidget.h"
+
+class StatsView : public QWidget
+{
+	Q_OBJECT
+public:
+	explicit StatsView(GLWidget *glWidget, QWidget *parent = nullptr);
+
+private:
+	GLWidget *glWidget;
+	QPlainTextEdit *text;
+	QPushButton *traceButton;
+	QTimer *timer;
+
+private slots:
+	void refresh();
+	void toggleTrace();
+};
+
+#endif // STATSVIEW_H
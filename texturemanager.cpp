@@ -0,0 +1,475 @@
+#include "texturemanager.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+struct BlockFormat
+{
+	GLenum internalFormat;
+	int blockBytes;	// bytes per 4x4 block, 0 for uncompressed RGBA8
+	GLenum format;	// client format of uncompressed data
+};
+
+const BlockFormat rgba8 = {GL_RGBA8, 0, GL_RGBA};
+
+quint32 read32(const QByteArray &data, int offset)
+{
+	return qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data.constData()) + offset);
+}
+
+quint64 read64(const QByteArray &data, int offset)
+{
+	return qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(data.constData()) + offset);
+}
+
+int levelBytes(const BlockFormat &format, int width, int height)
+{
+	if(format.blockBytes == 0) return width*height*4;
+	return std::max(1, (width + 3)/4)*std::max(1, (height + 3)/4)*format.blockBytes;
+}
+
+bool fromDXGI(quint32 dxgi, BlockFormat &format)
+{
+	switch(dxgi)
+	{
+	case 28: format = rgba8; return true;	// R8G8B8A8_UNORM
+	case 29: format = {GL_SRGB8_ALPHA8, 0, GL_RGBA}; return true;
+	case 87: format = {GL_RGBA8, 0, GL_BGRA}; return true;	// B8G8R8A8_UNORM
+	case 71: format = {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 8, 0}; return true;	// BC1
+	case 72: format = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 8, 0}; return true;
+	case 74: format = {GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 16, 0}; return true;	// BC2
+	case 75: format = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 16, 0}; return true;
+	case 77: format = {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 16, 0}; return true;	// BC3
+	case 78: format = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 16, 0}; return true;
+	case 80: format = {GL_COMPRESSED_RED_RGTC1, 8, 0}; return true;	// BC4
+	case 81: format = {GL_COMPRESSED_SIGNED_RED_RGTC1, 8, 0}; return true;
+	case 83: format = {GL_COMPRESSED_RG_RGTC2, 16, 0}; return true;	// BC5
+	case 84: format = {GL_COMPRESSED_SIGNED_RG_RGTC2, 16, 0}; return true;
+	case 95: format = {GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 16, 0}; return true;	// BC6H
+	case 96: format = {GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 16, 0}; return true;
+	case 98: format = {GL_COMPRESSED_RGBA_BPTC_UNORM, 16, 0}; return true;	// BC7
+	case 99: format = {GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 16, 0}; return true;
+	}
+	return false;
+}
+
+bool fromVkFormat(quint32 vkFormat, BlockFormat &format)
+{
+	switch(vkFormat)
+	{
+	case 37: format = rgba8; return true;	// R8G8B8A8_UNORM
+	case 43: format = {GL_SRGB8_ALPHA8, 0, GL_RGBA}; return true;
+	case 131: format = {GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 8, 0}; return true;	// BC1_RGB
+	case 132: format = {GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 8, 0}; return true;
+	case 133: format = {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 8, 0}; return true;	// BC1_RGBA
+	case 134: format = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 8, 0}; return true;
+	case 135: format = {GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 16, 0}; return true;	// BC2
+	case 136: format = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 16, 0}; return true;
+	case 137: format = {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 16, 0}; return true;	// BC3
+	case 138: format = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 16, 0}; return true;
+	case 139: format = {GL_COMPRESSED_RED_RGTC1, 8, 0}; return true;	// BC4
+	case 140: format = {GL_COMPRESSED_SIGNED_RED_RGTC1, 8, 0}; return true;
+	case 141: format = {GL_COMPRESSED_RG_RGTC2, 16, 0}; return true;	// BC5
+	case 142: format = {GL_COMPRESSED_SIGNED_RG_RGTC2, 16, 0}; return true;
+	case 143: format = {GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 16, 0}; return true;	// BC6H
+	case 144: format = {GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 16, 0}; return true;
+	case 145: format = {GL_COMPRESSED_RGBA_BPTC_UNORM, 16, 0}; return true;	// BC7
+	case 146: format = {GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 16, 0}; return true;
+	}
+	return false;
+}
+
+void describe(TextureData &data, const BlockFormat &format)
+{
+	data.internalFormat = format.internalFormat;
+	data.compressed = format.blockBytes != 0;
+	data.format = format.format;
+	data.type = GL_UNSIGNED_BYTE;
+	data.images.assign(size_t(data.levels)*data.layers*data.faces, QByteArray());
+}
+
+}
+
+size_t TextureData::bytes() const
+{
+	size_t total = 0;
+	for(const auto &image : images) total += image.size();
+	return total;
+}
+
+TextureManager::TextureManager(GLResources &resources) : resources(resources), budget(size_t(512) << 20) {}
+
+bool TextureManager::readDDS(const QString &path, TextureData &data, QString &error)
+{
+	/** CLARIFICATION:
+	 * A .dds file is the magic "DDS ", a 124 byte header, an optional 20 byte DX10 header, and then
+	 * the images ordered by array layer (or cubemap face), each with all of its mip levels.
+	 * Block-compressed images are kept as they are and handed to GL unchanged.
+	 **/
+
+	QFile file(path);
+	if(!file.open(QFile::ReadOnly)) { error = "Could not open " + path; return false; }
+	QByteArray bytes = file.readAll();
+	if(bytes.size() < 128 || !bytes.startsWith("DDS ")) { error = path + " is not a DDS file."; return false; }
+
+	quint32 flags = read32(bytes, 8);
+	data.height = read32(bytes, 12);
+	data.width = read32(bytes, 16);
+	data.levels = (flags & 0x20000) ? std::max<quint32>(1, read32(bytes, 28)) : 1;	// DDSD_MIPMAPCOUNT
+	quint32 pixelFlags = read32(bytes, 80);
+	quint32 fourCC = read32(bytes, 84);
+	quint32 caps2 = read32(bytes, 112);
+	data.faces = (caps2 & 0x200) ? 6 : 1;	// DDSCAPS2_CUBEMAP
+	data.layers = 1;
+	if(caps2 & 0x200000) { error = "Volume textures are not supported."; return false; }
+
+	int offset = 128;
+	BlockFormat format;
+	auto code = [](const char *c) { return quint32(c[0]) | quint32(c[1]) << 8 | quint32(c[2]) << 16 | quint32(c[3]) << 24; };
+	if(pixelFlags & 0x4)	// DDPF_FOURCC
+	{
+		if(fourCC == code("DXT1")) format = {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 8, 0};
+		else if(fourCC == code("DXT3")) format = {GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 16, 0};
+		else if(fourCC == code("DXT5")) format = {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 16, 0};
+		else if(fourCC == code("ATI1") || fourCC == code("BC4U")) format = {GL_COMPRESSED_RED_RGTC1, 8, 0};
+		else if(fourCC == code("BC4S")) format = {GL_COMPRESSED_SIGNED_RED_RGTC1, 8, 0};
+		else if(fourCC == code("ATI2") || fourCC == code("BC5U")) format = {GL_COMPRESSED_RG_RGTC2, 16, 0};
+		else if(fourCC == code("BC5S")) format = {GL_COMPRESSED_SIGNED_RG_RGTC2, 16, 0};
+		else if(fourCC == code("DX10"))
+		{
+			if(bytes.size() < 148) { error = path + " is truncated."; return false; }
+			if(!fromDXGI(read32(bytes, 128), format)) { error = "Unsupported DXGI format in " + path; return false; }
+			if(read32(bytes, 136) & 0x4) data.faces = 6;	// DDS_RESOURCE_MISC_TEXTURECUBE
+			data.layers = std::max<quint32>(1, read32(bytes, 140));
+			offset = 148;
+		}
+		else { error = "Unsupported DDS format in " + path; return false; }
+	}
+	else if((pixelFlags & 0x41) && read32(bytes, 88) == 32)	// 32 bit DDPF_RGB(A)
+	{
+		if(read32(bytes, 92) == 0x000000ff) format = rgba8;
+		else if(read32(bytes, 92) == 0x00ff0000) format = {GL_RGBA8, 0, GL_BGRA};
+		else { error = "Unsupported DDS channel layout in " + path; return false; }
+	}
+	else { error = "Unsupported DDS format in " + path; return false; }
+
+	describe(data, format);
+	for(int layer = 0; layer < data.layers; ++layer)
+		for(int face = 0; face < data.faces; ++face)
+			for(int level = 0; level < data.levels; ++level)
+			{
+				int size = levelBytes(format, std::max(1, data.width >> level), std::max(1, data.height >> level));
+				if(offset + size > bytes.size()) { error = path + " is truncated."; return false; }
+				data.image(level, layer, face) = bytes.mid(offset, size);
+				offset += size;
+			}
+	return true;
+}
+
+bool TextureManager::readKTX2(const QString &path, TextureData &data, QString &error)
+{
+	/** CLARIFICATION:
+	 * A .ktx2 file is a 12 byte identifier, a fixed header (format, size, layer, face and level counts),
+	 * a level index with the offset and length of every mip level, and the level data, where every level
+	 * holds the images of all layers and faces. Supercompressed files (Basis, zstd) would need a
+	 * transcoder, so only plain block-compressed or RGBA8 data is accepted.
+	 **/
+
+	QFile file(path);
+	if(!file.open(QFile::ReadOnly)) { error = "Could not open " + path; return false; }
+	QByteArray bytes = file.readAll();
+	static const char identifier[12] = {'\xAB', 'K', 'T', 'X', ' ', '2', '0', '\xBB', '\r', '\n', '\x1A', '\n'};
+	if(bytes.size() < 80 || memcmp(bytes.constData(), identifier, 12) != 0)
+	{
+		error = path + " is not a KTX2 file.";
+		return false;
+	}
+
+	BlockFormat format;
+	if(!fromVkFormat(read32(bytes, 12), format)) { error = "Unsupported KTX2 format in " + path; return false; }
+	data.width = read32(bytes, 20);
+	data.height = std::max<quint32>(1, read32(bytes, 24));
+	if(read32(bytes, 28) > 1) { error = "Volume textures are not supported."; return false; }
+	data.layers = std::max<quint32>(1, read32(bytes, 32));
+	data.faces = read32(bytes, 36) == 6 ? 6 : 1;
+	data.levels = std::max<quint32>(1, read32(bytes, 40));
+	if(read32(bytes, 44) != 0) { error = "Supercompressed KTX2 files are not supported."; return false; }
+
+	describe(data, format);
+	for(int level = 0; level < data.levels; ++level)
+	{
+		int index = 80 + level*24;
+		if(index + 24 > bytes.size()) { error = path + " is truncated."; return false; }
+		quint64 offset = read64(bytes, index);
+		quint64 length = read64(bytes, index + 8);
+		if(offset + length > quint64(bytes.size())) { error = path + " is truncated."; return false; }
+
+		int size = levelBytes(format, std::max(1, data.width >> level), std::max(1, data.height >> level));
+		if(quint64(size)*data.layers*data.faces > length) { error = path + " has an invalid level size."; return false; }
+		for(int layer = 0; layer < data.layers; ++layer)
+			for(int face = 0; face < data.faces; ++face)
+			{
+				data.image(level, layer, face) = bytes.mid(int(offset), size);
+				offset += size;
+			}
+	}
+	return true;
+}
+
+bool TextureManager::readImages(const QStringList &paths, Kind kind, TextureData &data, QString &error)
+{
+	if(kind == Cubemap && paths.size() != 6) { error = "A cubemap needs exactly 6 images."; return false; }
+	if(paths.isEmpty()) return false;
+
+	data.layers = kind == TextureArray ? paths.size() : 1;
+	data.faces = kind == Cubemap ? 6 : 1;
+	data.levels = 1;	// the mip chain is generated by GL after uploading
+
+	for(int i = 0; i < data.layers*data.faces; ++i)
+	{
+		QImage image = QImage(paths[i]);	// load image from path
+		if(image.isNull()) { error = "Could not load " + paths[i]; return false; }
+		image = image.convertToFormat(QImage::Format_RGBA8888, Qt::AutoColor);	// convert image to RGBA
+		if(kind != Cubemap) image = image.mirrored();	// flip it - cubemap faces are expected top-down
+
+		if(i == 0)
+		{
+			data.width = image.width();
+			data.height = image.height();
+			describe(data, rgba8);
+		}
+		else if(image.width() != data.width || image.height() != data.height)
+		{
+			error = "All images of an array or cubemap need to have the same size.";
+			return false;
+		}
+		data.images[i] = QByteArray(reinterpret_cast<const char*>(image.constBits()), data.width*data.height*4);
+	}
+	return true;
+}
+
+QList<QPair<QDateTime, qint64>> TextureManager::stampsOf(const QStringList &paths)
+{
+	QList<QPair<QDateTime, qint64>> stamps;
+	for(const QString &path : paths)
+	{
+		QFileInfo info(path);
+		stamps.append(qMakePair(info.lastModified(), info.size()));
+	}
+	return stamps;
+}
+
+bool TextureManager::load(const QString &slot, const QStringList &paths, Kind kind, QString &error)
+{
+	if(paths.isEmpty() || slot.isEmpty()) return false;
+
+	QString key = QString::number(kind) + ":" + paths.join('|');
+	auto stamps = stampsOf(paths);
+	auto cached = cache.find(key);
+
+	if(cached == cache.end() || cached->second.stamps != stamps)	// new or changed on disk, decode it
+	{
+		TextureData data;
+		QString suffix = QFileInfo(paths[0]).suffix().toLower();
+		bool read;
+		if(paths.size() == 1 && suffix == "dds") read = readDDS(paths[0], data, error);
+		else if(paths.size() == 1 && suffix == "ktx2") read = readKTX2(paths[0], data, error);
+		else read = readImages(paths, kind, data, error);
+		if(!read) return false;
+		data.array = kind == TextureArray || data.layers > 1;	// the slot decides, not how many files it got
+
+		CacheEntry entry;
+		if(!upload(data, entry, paths.join(", "), error)) return false;
+		entry.stamps = stamps;
+		entry.texture.setSize(entry.bytes);
+
+		if(cached != cache.end())	// swap the stale texture out, slots using it follow the key
+		{
+			entry.users = cached->second.users;
+			resident -= cached->second.bytes;
+			cached->second = std::move(entry);	// deletes the old texture
+		}
+		else cached = cache.emplace(key, std::move(entry)).first;
+		resident += cached->second.bytes;
+	}
+	cached->second.lastUse = ++clock;
+
+	auto current = std::find_if(bound.begin(), bound.end(),
+								[&slot](const QPair<QString, QString> &s) { return s.first == slot; });
+	if(current == bound.end())
+	{
+		bound.push_back(qMakePair(slot, key));
+		++cached->second.users;
+	}
+	else if(current->second != key)
+	{
+		--cache[current->second].users;
+		current->second = key;
+		++cached->second.users;
+	}
+
+	evict();
+	return true;
+}
+
+bool TextureManager::reload(const QString &path, QString &error)
+{
+	auto current = bound;	// load() may change the list while it is walked
+	bool reloaded = false;
+	for(const auto &slot : current)
+	{
+		int separator = slot.second.indexOf(':');
+		QStringList paths = slot.second.mid(separator + 1).split('|');
+		if(!paths.contains(path)) continue;
+		reloaded = load(slot.first, paths, Kind(slot.second.left(separator).toInt()), error) || reloaded;
+		// the file stamps changed, so load() decodes it again and only swaps the texture if that worked
+	}
+	return reloaded;
+}
+
+bool TextureManager::upload(TextureData &data, CacheEntry &entry, const QString &label, QString &error)
+{
+	if(data.faces == 6 && data.layers > 1) { error = "Cubemap arrays are not supported."; return false; }
+	if(data.faces == 6 && data.width != data.height) { error = "Cubemap faces need to be square."; return false; }
+
+	switch(data.internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		if(!GLEW_EXT_texture_compression_s3tc) { error = "The driver doesn't support BC1-BC3 (S3TC) textures."; return false; }
+		break;
+	case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+	case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT: case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+		if(!GLEW_VERSION_4_2 && !GLEW_ARB_texture_compression_bptc)
+		{
+			error = "The driver doesn't support BC6H/BC7 (BPTC) textures.";
+			return false;
+		}
+		break;
+	}
+	// BC4 and BC5 (RGTC) are core since GL 3.0
+
+	entry.target = data.faces == 6 ? GL_TEXTURE_CUBE_MAP : (data.array ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D);
+	while(glGetError() != GL_NO_ERROR);	// clear old errors, so only the upload is checked below
+
+	entry.texture = GLTexture(resources, label);
+	glBindTexture(entry.target, entry.texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for(int level = 0; level < data.levels; ++level)
+	{
+		int w = std::max(1, data.width >> level), h = std::max(1, data.height >> level);
+		if(entry.target == GL_TEXTURE_2D_ARRAY)	// all layers of a level are uploaded at once
+		{
+			QByteArray layers;
+			for(int layer = 0; layer < data.layers; ++layer) layers += data.image(level, layer, 0);
+			if(data.compressed)
+				glCompressedTexImage3D(entry.target, level, data.internalFormat, w, h, data.layers, 0,
+									   layers.size(), layers.constData());
+			else
+				glTexImage3D(entry.target, level, data.internalFormat, w, h, data.layers, 0,
+							 data.format, data.type, layers.constData());
+		}
+		else for(int face = 0; face < data.faces; ++face)
+		{
+			GLenum target = entry.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+			const QByteArray &image = data.image(level, 0, face);
+			if(data.compressed)
+				glCompressedTexImage2D(target, level, data.internalFormat, w, h, 0, image.size(), image.constData());
+			else
+				glTexImage2D(target, level, data.internalFormat, w, h, 0, data.format, data.type, image.constData());
+		}
+	}
+
+	bool generate = !data.compressed && data.levels == 1;
+	if(generate) glGenerateMipmap(entry.target);	// compressed data comes with its own mips, if any
+	glTexParameteri(entry.target, GL_TEXTURE_MAX_LEVEL, generate ? 1000 : data.levels - 1);
+	glTexParameteri(entry.target, GL_TEXTURE_MIN_FILTER,
+					generate || data.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(entry.target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	if(entry.target == GL_TEXTURE_CUBE_MAP)
+	{
+		glTexParameteri(entry.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(entry.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(entry.target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(entry.target, 0);
+
+	if(glGetError() != GL_NO_ERROR)
+	{
+		entry.texture.reset();
+		error = "The driver rejected the texture data.";
+		return false;
+	}
+
+	uploaded += data.bytes();
+	entry.bytes = data.bytes();
+	if(generate) entry.bytes += entry.bytes/3;	// a full mip chain adds a third
+	return true;
+}
+
+void TextureManager::evict()
+{
+	while(resident > budget)
+	{
+		auto oldest = cache.end();
+		for(auto i = cache.begin(); i != cache.end(); ++i)
+			if(i->second.users == 0 && (oldest == cache.end() || i->second.lastUse < oldest->second.lastUse))
+				oldest = i;
+		if(oldest == cache.end()) break;	// everything left is bound to a slot
+
+		resident -= oldest->second.bytes;
+		cache.erase(oldest);	// the handle deletes the texture
+	}
+}
+
+void TextureManager::remove(const QString &slot)
+{
+	for(auto i = bound.begin(); i != bound.end(); ++i)
+		if(i->first == slot)
+		{
+			--cache[i->second].users;
+			bound.erase(i);
+			break;
+		}
+	evict();
+}
+
+void TextureManager::setBudget(size_t bytes)
+{
+	budget = bytes;
+	evict();	// no-op while the context isn't current and nothing is resident
+}
+
+QStringList TextureManager::slotNames() const
+{
+	QStringList names;
+	for(const auto &slot : bound) names.append(slot.first);
+	return names;
+}
+
+void TextureManager::bind(GLState &state, GLuint program)
+{
+	for(size_t unit = 0; unit < bound.size(); ++unit)
+	{
+		const CacheEntry &entry = cache[bound[unit].second];
+		state.bindTexture(unit, entry.target, entry.texture);
+		state.uniform1i(state.uniformLocation(program, bound[unit].first.toUtf8().constData()), unit);
+	}
+	// every slot gets its own texture unit, and the sampler uniform with the slot's name points to it
+}
+
+void TextureManager::release()
+{
+	cache.clear();
+	bound.clear();
+	resident = 0;
+}
@@ -0,0 +1,75 @@
+#ifndef TEXTUREMANAGER_H
+#define TEXTUREMANAGER_H
+
+#include <map>
+#include <vector>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QDateTime>
+#include <QList>
+#include <QPair>
+#include <GL/glew.h>
+#include "glstate.h"
+#include "glresource.h"
+
+struct TextureData
+{
+	GLenum internalFormat = GL_RGBA8;
+	GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;	// only used for uncompressed data
+	bool compressed = false;
+	int width = 0, height = 0;
+	int layers = 1, faces = 1, levels = 1;	// faces is 6 for cubemaps
+	bool array = false;	// a 2D array even with a single layer, sampler2DArray needs one
+	std::vector<QByteArray> images;	// stored as [level][layer][face]
+
+	QByteArray &image(int level, int layer, int face) { return images[(level*layers + layer)*faces + face]; }
+	size_t bytes() const;
+};
+
+class TextureManager
+{
+public:
+	enum Kind { Texture2D, TextureArray, Cubemap };
+
+	explicit TextureManager(GLResources&);
+
+	// the functions below need the GL context to be current
+	bool load(const QString &slot, const QStringList &paths, Kind, QString &error);
+	bool reload(const QString &path, QString &error);
+	void remove(const QString &slot);
+	void bind(GLState&, GLuint program);
+	void release();
+
+	void setBudget(size_t bytes);
+	size_t residentBytes() const { return resident; }
+	size_t takeUploadedBytes() { size_t bytes = uploaded; uploaded = 0; return bytes; }
+	QStringList slotNames() const;
+
+	static bool readDDS(const QString&, TextureData&, QString&);
+	static bool readKTX2(const QString&, TextureData&, QString&);
+	static bool readImages(const QStringList&, Kind, TextureData&, QString&);
+
+private:
+	struct CacheEntry
+	{
+		GLTexture texture;
+		GLenum target = GL_TEXTURE_2D;
+		size_t bytes = 0;
+		QList<QPair<QDateTime, qint64>> stamps;	// modification time and size of every source file
+		quint64 lastUse = 0;
+		int users = 0;	// slots currently referencing the texture
+	};
+
+	GLResources &resources;
+	std::map<QString, CacheEntry> cache;	// keyed by the kind and source paths
+	std::vector<QPair<QString, QString>> bound;	// slot name and cache key - index is the texture unit
+	size_t budget, resident = 0, uploaded = 0;
+	quint64 clock = 0;	// incremented on every use, orders the entries for LRU eviction
+
+	bool upload(TextureData&, CacheEntry&, const QString&, QString&);
+	void evict();
+	static QList<QPair<QDateTime, qint64>> stampsOf(const QStringList&);
+};
+
+#endif // TEXTUREMANAGER_H